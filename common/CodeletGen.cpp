@@ -0,0 +1,144 @@
+#include "CodeletGen.h"
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+using namespace std;
+
+// appends one printf-formatted line of generated source
+static void emit(string &src, const char *fmt, ...)
+{
+  char line[512];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  src += line;
+  src += "\n";
+}
+
+CodeletPlan codeletPlan(unsigned int points)
+{
+  CodeletPlan plan;
+  plan.points = points;
+  plan.stride = 1;
+  plan.batch_stride = points;
+  unsigned int left = points;
+  while(left >= 8)
+  {
+    plan.radices.push_back(8);
+    left >>= 3;
+  }
+  if(left > 1)
+    plan.radices.push_back(left);
+  return plan;
+}
+
+string codeletKernelName(const CodeletPlan &plan)
+{
+  char name[64];
+  sprintf(name, "FFT2_CODELET_%u", plan.points);
+  return name;
+}
+
+// x[b] times exp(-2 pi i j / m), with the direction d applied to the sine; the
+// trivial twiddles 1 and -i (times d) cost no multiplications
+static void emitTwiddle(string &src, unsigned int b, unsigned int j, unsigned int m)
+{
+  if(j == 0)
+  {
+    emit(src, "  t = x%u;", b);
+    return;
+  }
+  if(4 * j == m)
+  {
+    emit(src, "  t = (real2)(x%u.s1 * d, -x%u.s0 * d);", b, b);
+    return;
+  }
+  double c = cos(2.0 * M_PI * j / m);
+  double s = sin(2.0 * M_PI * j / m);
+  emit(src, "  t = (real2)(x%u.s0 * (real)%.17g + x%u.s1 * (d * (real)%.17g), x%u.s1 * (real)%.17g - x%u.s0 * (d * (real)%.17g));",
+       b, c, b, s, b, c, b, s);
+}
+
+string generateCodelet(const CodeletPlan &plan)
+{
+  string src;
+  unsigned int n = plan.points;
+  string schedule;
+  for(size_t p = 0; p < plan.radices.size(); p++)
+  {
+    char r[16];
+    sprintf(r, " %u", plan.radices[p]);
+    schedule += r;
+  }
+  emit(src, "");
+  emit(src, "// generated by CodeletGen: %u points, radix schedule%s", n, schedule.c_str());
+  emit(src, "__kernel void %s(__global real2 * a, __local real2 * l, __global const uint * points_per_group, __global real2 * debug, __global const int * dir)",
+       codeletKernelName(plan).c_str());
+  emit(src, "{");
+  emit(src, "  __global real2 * g = a + get_global_id(0) * %u;", plan.batch_stride);
+  emit(src, "  real d = (real)(*dir);");
+  emit(src, "  real2 t;");
+  for(unsigned int i = 0; i < n; i++)
+    emit(src, "  real2 x%u = g[%u];", i, i * plan.stride);
+
+  // each pass runs its log2(radix) stages set by set, so a set's points stay together
+  unsigned int stage = 0;
+  for(size_t p = 0; p < plan.radices.size(); p++)
+  {
+    unsigned int bits = 0;
+    while((1u << bits) < plan.radices[p])
+      bits++;
+    emit(src, "  // pass %u: radix %u, stages %u..%u", (unsigned int)p, plan.radices[p], stage, stage + bits - 1);
+    unsigned int span = 1u << stage;                  // distance between the points of a set
+    unsigned int sets = n >> bits;
+    for(unsigned int k = 0; k < sets; k++)
+    {
+      unsigned int first = ((k / span) << (stage + bits)) + k % span;
+      for(unsigned int t = 0; t < bits; t++)
+      {
+        unsigned int half = 1u << t;
+        unsigned int m = span << (t + 1);             // block size of stage + t
+        for(unsigned int r = 0; r < plan.radices[p]; r++)
+        {
+          if(r & half)
+            continue;
+          unsigned int u = first + r * span;
+          unsigned int v = u + half * span;
+          emitTwiddle(src, v, u % m, m);
+          emit(src, "  x%u = x%u - t;", v, u);
+          emit(src, "  x%u = x%u + t;", u, u);
+        }
+      }
+    }
+    stage += bits;
+  }
+
+  for(unsigned int i = 0; i < n; i++)
+    emit(src, "  g[%u] = x%u;", i * plan.stride, i);
+  emit(src, "}");
+  return src;
+}
+
+unsigned int codeletPoints(size_t n)
+{
+  if(n < CODELET_MIN_POINTS)
+    return 0;
+  return (n < CODELET_MAX_POINTS) ? (unsigned int)n : CODELET_MAX_POINTS;
+}
+
+LaunchConfig codeletLaunchConfig(size_t n)
+{
+  LaunchConfig config;
+  unsigned int points = codeletPoints(n);
+  config.points_per_group = points;
+  config.points_per_item = points;
+  config.radix = points;
+  config.szLocalWorkSize = 1;
+  config.szGlobalWorkSize = n / points;
+  // the codelet never touches l, but the argument still needs a size
+  config.local_mem_size = sizeof(cl_double2) * groupScratchPoints(points, points);
+  config.microseconds = 0.0;
+  return config;
+}
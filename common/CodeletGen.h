@@ -0,0 +1,48 @@
+#ifndef _CODELETGEN_H_
+#define _CODELETGEN_H_
+
+#include "Tuner.h"
+#include <string>
+#include <vector>
+
+/* Groups of CODELET_MIN_POINTS to CODELET_MAX_POINTS points run as a generated codelet;
+   smaller ones already fit FFT2 / FFT2_R8 in one pass, larger ones would spill the
+   registers of the one work-item that holds them. */
+#define CODELET_MIN_POINTS 16
+#define CODELET_MAX_POINTS 64
+
+/* What a straight-line codelet is generated from: the size, how its radix-2 stages
+   are grouped into passes, and where its points live. */
+struct CodeletPlan
+{
+    unsigned int points;                /* power of 2, one work-item holds all of them */
+    std::vector<unsigned int> radices;  /* passes in order, their product is points */
+    unsigned int stride;                /* distance between the points of one transform */
+    unsigned int batch_stride;          /* distance between the transforms of neighbouring work-items */
+};
+
+/* Radix-8 passes first, the remainder last, over contiguous groups of points each
+   (the FFT2 layout): work-item i transforms the group at i * points. */
+CodeletPlan codeletPlan(unsigned int points);
+
+/* Name of the generated kernel, e.g. FFT2_CODELET_32. */
+std::string codeletKernelName(const CodeletPlan &plan);
+
+/* OpenCL source of a fully unrolled kernel with FFT2's arguments and contract
+   (bit reversed points in, the decimation-in-time stages run): no loops, no
+   runtime index arithmetic, the twiddles as literals. It uses real2 and
+   mul_complex, so it is built after FFT2.cl in the same program. */
+std::string generateCodelet(const CodeletPlan &plan);
+
+/* Points per group of the codelet for an n-point transform: n itself up to
+   CODELET_MAX_POINTS, CODELET_MAX_POINTS above it, 0 below CODELET_MIN_POINTS. */
+unsigned int codeletPoints(size_t n);
+
+/* The codelet of codeletPoints(n) points as the in-group kernel: one work-item per
+   group, n/points of them. The cross-group stages follow as they do after FFT2
+   (FFT2_ALL_POINTS or the host tail). Above CODELET_MAX_POINTS those one-item groups
+   cover far fewer stages than FFT2_R8's, so there it is only used when the tuner has
+   measured it faster; untuned it is the default for whole transforms alone. */
+LaunchConfig codeletLaunchConfig(size_t n);
+
+#endif
@@ -0,0 +1,135 @@
+// Batched radix-2 stages for device resident convolution. Every row of n points is
+// transformed in place: the forward pass is decimation in frequency (natural order in,
+// bit reversed order out) and the inverse is decimation in time (bit reversed in,
+// natural out), so spectra are multiplied without ever being reordered.
+// twiddles[half + j] = exp(-i*pi*j/half), the inverse uses the conjugate.
+
+float2 mul_complex(float2 a, float2 b)
+{
+  return (float2)(a.s0*b.s0 - a.s1*b.s1,a.s0*b.s1 + a.s1*b.s0);
+}
+
+float2 twiddle(__global const float2 * twiddles, uint index, int dir)
+{
+  float2 w = twiddles[index];
+  return (dir < 0) ? (float2)(w.s0, -w.s1) : w;
+}
+
+// one stage of span 2*half over all rows, one butterfly per work-item
+__kernel void CONV_DIF_STAGE(__global float2 * a, __global const float2 * twiddles, const uint n, const uint half, const int dir)
+{
+  uint g = get_global_id(0);
+  uint row = g / (n >> 1);
+  uint b = g - row * (n >> 1);
+  uint j = b & (half - 1);
+  uint k = row * n + ((b - j) << 1) + j;
+
+  float2 u = a[k];
+  float2 v = a[k + half];
+  a[k] = u + v;
+  a[k + half] = mul_complex(u - v, twiddle(twiddles, half + j, dir));
+}
+
+__kernel void CONV_DIT_STAGE(__global float2 * a, __global const float2 * twiddles, const uint n, const uint half, const int dir)
+{
+  uint g = get_global_id(0);
+  uint row = g / (n >> 1);
+  uint b = g - row * (n >> 1);
+  uint j = b & (half - 1);
+  uint k = row * n + ((b - j) << 1) + j;
+
+  float2 u = a[k];
+  float2 v = mul_complex(a[k + half], twiddle(twiddles, half + j, dir));
+  a[k] = u + v;
+  a[k + half] = u - v;
+}
+
+// input-pruned CONV_DIF_STAGE: everything past the first live points (live <= half) of each
+// block of 2*half is known to be zero, so v is zero, a[k] keeps u and nothing past live is touched;
+// live work-items per block
+__kernel void CONV_DIF_PRUNED_STAGE(__global float2 * a, __global const float2 * twiddles, const uint n, const uint half,
+                                    const uint live, const int dir)
+{
+  uint g = get_global_id(0);
+  uint per_row = (n / (half << 1)) * live;
+  uint row = g / per_row;
+  uint b = g - row * per_row;
+  uint j = b & (live - 1);
+  uint k = row * n + (b / live) * (half << 1) + j;
+
+  a[k + half] = mul_complex(a[k], twiddle(twiddles, half + j, dir));
+}
+
+// output-pruned CONV_DIT_STAGE: only the first live points (live <= half) of each block of 2*half
+// are ever read again, so the upper half of the butterfly is dropped
+__kernel void CONV_DIT_PRUNED_STAGE(__global float2 * a, __global const float2 * twiddles, const uint n, const uint half,
+                                    const uint live, const int dir)
+{
+  uint g = get_global_id(0);
+  uint per_row = (n / (half << 1)) * live;
+  uint row = g / per_row;
+  uint b = g - row * per_row;
+  uint j = b & (live - 1);
+  uint k = row * n + (b / live) * (half << 1) + j;
+
+  a[k] = a[k] + mul_complex(a[k + half], twiddle(twiddles, half + j, dir));
+}
+
+// the remaining stages of span <= 2*get_local_size(0), one block of span points per group
+__kernel void CONV_DIF_LOCAL(__global float2 * a, __local float2 * l, __global const float2 * twiddles, const uint span, const int dir)
+{
+  uint lid = get_local_id(0);
+  uint base = get_group_id(0) * span;
+  uint items = span >> 1;
+
+  l[lid] = a[base + lid];
+  l[lid + items] = a[base + lid + items];
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for(uint half = items; half >= 1; half >>= 1)
+  {
+    uint j = lid & (half - 1);
+    uint k = ((lid - j) << 1) + j;
+    float2 u = l[k];
+    float2 v = l[k + half];
+    l[k] = u + v;
+    l[k + half] = mul_complex(u - v, twiddle(twiddles, half + j, dir));
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  a[base + lid] = l[lid];
+  a[base + lid + items] = l[lid + items];
+}
+
+// the first stages of span <= 2*get_local_size(0), one block of span points per group
+__kernel void CONV_DIT_LOCAL(__global float2 * a, __local float2 * l, __global const float2 * twiddles, const uint span, const int dir)
+{
+  uint lid = get_local_id(0);
+  uint base = get_group_id(0) * span;
+  uint items = span >> 1;
+
+  l[lid] = a[base + lid];
+  l[lid + items] = a[base + lid + items];
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for(uint half = 1; half < span; half <<= 1)
+  {
+    uint j = lid & (half - 1);
+    uint k = ((lid - j) << 1) + j;
+    float2 u = l[k];
+    float2 v = mul_complex(l[k + half], twiddle(twiddles, half + j, dir));
+    l[k] = u + v;
+    l[k + half] = u - v;
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  a[base + lid] = l[lid];
+  a[base + lid + items] = l[lid + items];
+}
+
+// a[i] = a[i] * b[b_offset + i % b_points] * scale; b may alias a as long as the ranges don't overlap
+__kernel void CONV_POINTWISE(__global float2 * a, __global const float2 * b, const uint b_offset, const uint b_points, const float scale)
+{
+  uint i = get_global_id(0);
+  a[i] = mul_complex(a[i], b[b_offset + i % b_points]) * scale;
+}
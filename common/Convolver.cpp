@@ -0,0 +1,275 @@
+#include "Convolver.h"
+#include "oclFFT.h"
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+Convolver::Convolver(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue, int argc, const char **argv)
+    : cxContext(cxContext), cqCommandQueue(cqCommandQueue), cmTwiddles(NULL), twiddle_points(0)
+{
+  cl_int ciErr;
+  size_t szKernelLength;
+  // next to the executable when installed, in the shared source directory when run from the tree
+  char* cPathAndName = shrFindFilePath("Convolve.cl", argv[0]);
+  if(cPathAndName == NULL)
+    cPathAndName = shrFindFilePath("../common/Convolve.cl", argv[0]);
+  cSourceCL = oclLoadProgSource(cPathAndName, "", &szKernelLength);
+  free(cPathAndName);
+
+  cpProgram = clCreateProgramWithSource(cxContext, 1, (const char **)&cSourceCL, &szKernelLength, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateProgramWithSource, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  ciErr = clBuildProgram(cpProgram, 1, &cdDevice, NULL, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    size_t log_size;
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+    char* program_log = (char *)malloc(log_size + 1);
+    program_log[log_size] = '\0';
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, log_size + 1, program_log, NULL);
+    printf("%s\n", program_log);
+    free(program_log);
+    shrLog("Error in clBuildProgram, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ckDIFStage = clCreateKernel(cpProgram, "CONV_DIF_STAGE", &ciErr);
+  ckDITStage = clCreateKernel(cpProgram, "CONV_DIT_STAGE", &ciErr);
+  ckDIFPruned = clCreateKernel(cpProgram, "CONV_DIF_PRUNED_STAGE", &ciErr);
+  ckDITPruned = clCreateKernel(cpProgram, "CONV_DIT_PRUNED_STAGE", &ciErr);
+  ckDIFLocal = clCreateKernel(cpProgram, "CONV_DIF_LOCAL", &ciErr);
+  ckDITLocal = clCreateKernel(cpProgram, "CONV_DIT_LOCAL", &ciErr);
+  ckPointwise = clCreateKernel(cpProgram, "CONV_POINTWISE", &ciErr);
+  // each call overwrites ciErr, but a failed one leaves its kernel NULL
+  if (ckDIFStage == NULL || ckDITStage == NULL || ckDIFPruned == NULL || ckDITPruned == NULL ||
+      ckDIFLocal == NULL || ckDITLocal == NULL || ckPointwise == NULL)
+  {
+    shrLog("Error in clCreateKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // a block of span points takes span/2 work-items and span float2s of local memory
+  size_t dif_items, dit_items;
+  cl_ulong local_memory_size;
+  ciErr = clGetKernelWorkGroupInfo(ckDIFLocal, cdDevice, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), (void *)&dif_items, NULL);
+  ciErr |= clGetKernelWorkGroupInfo(ckDITLocal, cdDevice, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), (void *)&dit_items, NULL);
+  ciErr |= clGetDeviceInfo(cdDevice, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), (void *)&local_memory_size, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clGetKernelWorkGroupInfo, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  size_t items = min(dif_items, dit_items);
+  max_span = 2;
+  while(max_span < 2 * items && 2 * max_span * sizeof(cl_float2) <= local_memory_size / 2)
+    max_span <<= 1;
+}
+
+Convolver::~Convolver()
+{
+  if(cmTwiddles)clReleaseMemObject(cmTwiddles);
+  if(ckPointwise)clReleaseKernel(ckPointwise);
+  if(ckDITLocal)clReleaseKernel(ckDITLocal);
+  if(ckDIFLocal)clReleaseKernel(ckDIFLocal);
+  if(ckDITPruned)clReleaseKernel(ckDITPruned);
+  if(ckDIFPruned)clReleaseKernel(ckDIFPruned);
+  if(ckDITStage)clReleaseKernel(ckDITStage);
+  if(ckDIFStage)clReleaseKernel(ckDIFStage);
+  if(cpProgram)clReleaseProgram(cpProgram);
+  if(cSourceCL)free(cSourceCL);
+}
+
+size_t Convolver::transformSize(size_t len)
+{
+  size_t n = 2;
+  while(n < len)
+    n <<= 1;
+  return n;
+}
+
+// The table for n holds the one for every smaller size, so it only ever grows.
+void Convolver::loadTwiddles(size_t n, int argc, const char **argv)
+{
+  if(n <= twiddle_points)
+    return;
+
+  vector<cl_float2> table(n);
+  for(size_t half = 1; half < n; half <<= 1)
+  {
+    for(size_t j = 0; j < half; j++)
+    {
+      double angle = -M_PI * (double)j / half;
+      table[half + j].x = (float)cos(angle);
+      table[half + j].y = (float)sin(angle);
+    }
+  }
+
+  cl_int ciErr;
+  if(cmTwiddles)clReleaseMemObject(cmTwiddles);
+  cmTwiddles = clCreateBuffer(cxContext, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(cl_float2) * n, &table[0], &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  twiddle_points = n;
+}
+
+void Convolver::enqueue(cl_kernel ckKernel, size_t szGlobalWorkSize, size_t szLocalWorkSize, int argc, const char **argv)
+{
+  cl_int ciErr = clEnqueueNDRangeKernel(cqCommandQueue, ckKernel, 1, NULL, &szGlobalWorkSize,
+                                        szLocalWorkSize ? &szLocalWorkSize : NULL, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
+
+void Convolver::globalStage(cl_kernel ckKernel, cl_mem cmData, size_t n, size_t batch, cl_uint half, cl_int dir,
+                            int argc, const char **argv)
+{
+  cl_uint points = (cl_uint)n;
+  cl_int ciErr = clSetKernelArg(ckKernel, 0, sizeof(cl_mem), (void*)&cmData);
+  ciErr |= clSetKernelArg(ckKernel, 1, sizeof(cl_mem), (void*)&cmTwiddles);
+  ciErr |= clSetKernelArg(ckKernel, 2, sizeof(cl_uint), (void*)&points);
+  ciErr |= clSetKernelArg(ckKernel, 3, sizeof(cl_uint), (void*)&half);
+  ciErr |= clSetKernelArg(ckKernel, 4, sizeof(cl_int), (void*)&dir);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  enqueue(ckKernel, batch * n / 2, 0, argc, argv);
+}
+
+void Convolver::prunedStage(cl_kernel ckKernel, cl_mem cmData, size_t n, size_t batch, cl_uint half, cl_uint live, cl_int dir,
+                            int argc, const char **argv)
+{
+  cl_uint points = (cl_uint)n;
+  cl_int ciErr = clSetKernelArg(ckKernel, 0, sizeof(cl_mem), (void*)&cmData);
+  ciErr |= clSetKernelArg(ckKernel, 1, sizeof(cl_mem), (void*)&cmTwiddles);
+  ciErr |= clSetKernelArg(ckKernel, 2, sizeof(cl_uint), (void*)&points);
+  ciErr |= clSetKernelArg(ckKernel, 3, sizeof(cl_uint), (void*)&half);
+  ciErr |= clSetKernelArg(ckKernel, 4, sizeof(cl_uint), (void*)&live);
+  ciErr |= clSetKernelArg(ckKernel, 5, sizeof(cl_int), (void*)&dir);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  enqueue(ckKernel, batch * (n / (2 * half)) * live, 0, argc, argv);
+}
+
+void Convolver::localStages(cl_kernel ckKernel, cl_mem cmData, size_t n, size_t batch, cl_uint span, cl_int dir,
+                            int argc, const char **argv)
+{
+  cl_int ciErr = clSetKernelArg(ckKernel, 0, sizeof(cl_mem), (void*)&cmData);
+  ciErr |= clSetKernelArg(ckKernel, 1, sizeof(cl_float2) * span, NULL);
+  ciErr |= clSetKernelArg(ckKernel, 2, sizeof(cl_mem), (void*)&cmTwiddles);
+  ciErr |= clSetKernelArg(ckKernel, 3, sizeof(cl_uint), (void*)&span);
+  ciErr |= clSetKernelArg(ckKernel, 4, sizeof(cl_int), (void*)&dir);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  enqueue(ckKernel, batch * n / 2, span / 2, argc, argv);
+}
+
+void Convolver::forward(cl_mem cmData, size_t n, size_t batch, int argc, const char **argv, cl_int dir,
+                        size_t input_points)
+{
+  loadTwiddles(n, argc, argv);
+  size_t span = min(n, max_span);
+  size_t live = (input_points > 0) ? min(n, transformSize(input_points)) : n;
+  // wide stages one launch each, then everything that fits a work-group in one go; while a
+  // block's upper half is still all zeros its stage is just the twiddled copy of the lower half
+  for(size_t half = n / 2; half >= span; half >>= 1)
+  {
+    if(half >= live)
+      prunedStage(ckDIFPruned, cmData, n, batch, (cl_uint)half, (cl_uint)live, dir, argc, argv);
+    else
+      globalStage(ckDIFStage, cmData, n, batch, (cl_uint)half, dir, argc, argv);
+  }
+  localStages(ckDIFLocal, cmData, n, batch, (cl_uint)span, dir, argc, argv);
+}
+
+void Convolver::inverse(cl_mem cmData, size_t n, size_t batch, int argc, const char **argv, size_t output_points)
+{
+  loadTwiddles(n, argc, argv);
+  size_t span = min(n, max_span);
+  size_t live = (output_points > 0) ? min(n, transformSize(output_points)) : n;
+  localStages(ckDITLocal, cmData, n, batch, (cl_uint)span, -1, argc, argv);
+  // once only the low live points of a block are read, its upper outputs are never computed
+  for(size_t half = span; half < n; half <<= 1)
+  {
+    if(half >= live)
+      prunedStage(ckDITPruned, cmData, n, batch, (cl_uint)half, (cl_uint)live, -1, argc, argv);
+    else
+      globalStage(ckDITStage, cmData, n, batch, (cl_uint)half, -1, argc, argv);
+  }
+}
+
+void Convolver::multiply(cl_mem cmA, cl_mem cmB, size_t points, size_t b_offset, size_t b_points, float scale,
+                         int argc, const char **argv)
+{
+  cl_uint offset = (cl_uint)b_offset;
+  cl_uint period = (cl_uint)b_points;
+  cl_int ciErr = clSetKernelArg(ckPointwise, 0, sizeof(cl_mem), (void*)&cmA);
+  ciErr |= clSetKernelArg(ckPointwise, 1, sizeof(cl_mem), (void*)&cmB);
+  ciErr |= clSetKernelArg(ckPointwise, 2, sizeof(cl_uint), (void*)&offset);
+  ciErr |= clSetKernelArg(ckPointwise, 3, sizeof(cl_uint), (void*)&period);
+  ciErr |= clSetKernelArg(ckPointwise, 4, sizeof(cl_float), (void*)&scale);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  enqueue(ckPointwise, points, 0, argc, argv);
+}
+
+vector<double> Convolver::convolve(const vector<double>& a, const vector<double>& b, int argc, const char **argv)
+{
+  size_t len = a.size() + b.size() - 1;
+  size_t n = transformSize(len);
+
+  // both operands side by side in one buffer: a in row 0, b in row 1
+  vector<cl_float2> host(2 * n);
+  for(size_t i = 0; i < 2 * n; i++)
+    host[i].x = host[i].y = 0.0f;
+  for(size_t i = 0; i < a.size(); i++)
+    host[i].x = (float)a[i];
+  for(size_t i = 0; i < b.size(); i++)
+    host[n + i].x = (float)b[i];
+
+  cl_int ciErr;
+  cl_mem cmData = clCreateBuffer(cxContext, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_float2) * 2 * n, &host[0], &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // both rows are zero past the longer operand, and only the first len coefficients are read
+  forward(cmData, n, 2, argc, argv, 1, max(a.size(), b.size()));
+  multiply(cmData, cmData, n, n, n, 1.0f / n, argc, argv);
+  inverse(cmData, n, 1, argc, argv, len);
+
+  ciErr = clEnqueueReadBuffer(cqCommandQueue, cmData, CL_TRUE, 0, sizeof(cl_float2) * len, &host[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  clReleaseMemObject(cmData);
+
+  vector<double> c(len);
+  for(size_t i = 0; i < len; i++)
+    c[i] = host[i].x;
+  return c;
+}
@@ -0,0 +1,65 @@
+#ifndef _CONVOLVER_H_
+#define _CONVOLVER_H_
+
+#include <oclUtils.h>
+#include <vector>
+
+/* Convolution that keeps both spectra on the device. Rows of n complex points
+   (n a power of 2) are transformed in place by Convolve.cl: the forward pass
+   leaves the spectrum in bit reversed order and the inverse takes it back, so
+   no reordering kernel or host round trip sits between the two. */
+class Convolver
+{
+    public:
+        /* Builds Convolve.cl for the device behind cqCommandQueue. */
+        Convolver(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue, int argc, const char **argv);
+        ~Convolver();
+
+        /* Forward transform of batch consecutive rows of n points, natural order in, bit reversed out.
+           dir = -1 runs the same pass with conjugate twiddles. When only the first input_points of
+           every row can be non-zero (zero padding), the wide stages skip the known zeros; 0 means n. */
+        void forward(cl_mem cmData, size_t n, size_t batch, int argc, const char **argv, cl_int dir = 1,
+                     size_t input_points = 0);
+        /* Unscaled inverse of forward, bit reversed in, natural order out. With output_points > 0
+           only the first output_points of every row are computed and the rest is left undefined. */
+        void inverse(cl_mem cmData, size_t n, size_t batch, int argc, const char **argv, size_t output_points = 0);
+        /* a[i] = a[i] * b[b_offset + i % b_points] * scale for i < points. cmB may be cmA. */
+        void multiply(cl_mem cmA, cl_mem cmB, size_t points, size_t b_offset, size_t b_points, float scale,
+                      int argc, const char **argv);
+
+        /* Linear convolution of two real sequences: one upload, both forward transforms,
+           the product and the inverse on the device, one download of the coefficients. */
+        std::vector<double> convolve(const std::vector<double>& a, const std::vector<double>& b,
+                                     int argc, const char **argv);
+
+        /* Power of 2 that holds a linear convolution of len points. */
+        static size_t transformSize(size_t len);
+
+    private:
+        cl_context cxContext;
+        cl_command_queue cqCommandQueue;
+        cl_program cpProgram;
+        cl_kernel ckDIFStage;
+        cl_kernel ckDITStage;
+        cl_kernel ckDIFPruned;
+        cl_kernel ckDITPruned;
+        cl_kernel ckDIFLocal;
+        cl_kernel ckDITLocal;
+        cl_kernel ckPointwise;
+        cl_mem cmTwiddles;
+        size_t twiddle_points;
+        size_t max_span;        /* largest block the local kernels finish in one launch */
+        char* cSourceCL;
+
+        void loadTwiddles(size_t n, int argc, const char **argv);
+        void enqueue(cl_kernel ckKernel, size_t szGlobalWorkSize, size_t szLocalWorkSize, int argc, const char **argv);
+        void globalStage(cl_kernel ckKernel, cl_mem cmData, size_t n, size_t batch, cl_uint half, cl_int dir,
+                         int argc, const char **argv);
+        /* A global stage that only works on the first live points of every block of 2*half. */
+        void prunedStage(cl_kernel ckKernel, cl_mem cmData, size_t n, size_t batch, cl_uint half, cl_uint live, cl_int dir,
+                         int argc, const char **argv);
+        void localStages(cl_kernel ckKernel, cl_mem cmData, size_t n, size_t batch, cl_uint span, cl_int dir,
+                         int argc, const char **argv);
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include "CpuEngine.h"
+#include <unistd.h>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+struct WorkerStart
+{
+    CpuEngine *engine;
+    int thread;
+};
+
+CpuEngine::CpuEngine(int num_threads)
+    : num_threads(num_threads), generation(0), pending(0), shutting_down(false),
+      job_fn(NULL), job_arg(NULL), job_count(0)
+{
+  if(this->num_threads <= 0)
+  {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    this->num_threads = cores > 0 ? (int)cores : 1;
+  }
+  pthread_mutex_init(&lock, NULL);
+  pthread_mutex_init(&submit, NULL);
+  pthread_mutex_init(&table_lock, NULL);
+  pthread_cond_init(&work_ready, NULL);
+  pthread_cond_init(&work_done, NULL);
+
+  // the calling thread takes share 0, workers take the rest
+  workers.resize(this->num_threads - 1);
+  for(int t = 1; t < this->num_threads; t++)
+  {
+    WorkerStart *start = new WorkerStart;
+    start->engine = this;
+    start->thread = t;
+    pthread_create(&workers[t-1], NULL, workerMain, start);
+  }
+}
+
+CpuEngine::~CpuEngine()
+{
+  pthread_mutex_lock(&lock);
+  shutting_down = true;
+  pthread_cond_broadcast(&work_ready);
+  pthread_mutex_unlock(&lock);
+  for(size_t t = 0; t < workers.size(); t++)
+    pthread_join(workers[t], NULL);
+  pthread_cond_destroy(&work_done);
+  pthread_cond_destroy(&work_ready);
+  pthread_mutex_destroy(&table_lock);
+  pthread_mutex_destroy(&submit);
+  pthread_mutex_destroy(&lock);
+  for(size_t i = 0; i < forward_tables.size(); i++)
+    delete forward_tables[i];
+  for(size_t i = 0; i < inverse_tables.size(); i++)
+    delete inverse_tables[i];
+}
+
+CpuEngine &CpuEngine::shared()
+{
+  static CpuEngine engine;
+  return engine;
+}
+
+void *CpuEngine::workerMain(void *arg)
+{
+  WorkerStart *start = (WorkerStart *)arg;
+  CpuEngine *engine = start->engine;
+  int thread = start->thread;
+  delete start;
+
+  unsigned long seen = 0;
+  for(;;)
+  {
+    pthread_mutex_lock(&engine->lock);
+    while(engine->generation == seen && !engine->shutting_down)
+      pthread_cond_wait(&engine->work_ready, &engine->lock);
+    if(engine->shutting_down)
+    {
+      pthread_mutex_unlock(&engine->lock);
+      return NULL;
+    }
+    seen = engine->generation;
+    pthread_mutex_unlock(&engine->lock);
+
+    engine->runShare(thread);
+
+    pthread_mutex_lock(&engine->lock);
+    if(--engine->pending == 0)
+      pthread_cond_signal(&engine->work_done);
+    pthread_mutex_unlock(&engine->lock);
+  }
+}
+
+void CpuEngine::runShare(int thread)
+{
+  size_t first = job_count * thread / num_threads;
+  size_t last = job_count * (thread + 1) / num_threads;
+  if(first < last)
+    job_fn(job_arg, first, last);
+}
+
+void CpuEngine::parallelFor(size_t count, void (*fn)(void *, size_t, size_t), void *arg)
+{
+  // another thread's job has the pool: run this one here rather than queue behind it
+  if(num_threads == 1 || count < 2 || pthread_mutex_trylock(&submit) != 0)
+  {
+    fn(arg, 0, count);
+    return;
+  }
+
+  pthread_mutex_lock(&lock);
+  job_fn = fn;
+  job_arg = arg;
+  job_count = count;
+  pending = num_threads - 1;
+  ++generation;
+  pthread_cond_broadcast(&work_ready);
+  pthread_mutex_unlock(&lock);
+
+  runShare(0);
+
+  pthread_mutex_lock(&lock);
+  while(pending > 0)
+    pthread_cond_wait(&work_done, &lock);
+  pthread_mutex_unlock(&lock);
+  pthread_mutex_unlock(&submit);
+}
+
+const float *CpuEngine::twiddles(size_t m, int dir)
+{
+  vector<vector<float> *> &tables = (dir < 0) ? inverse_tables : forward_tables;
+  pthread_mutex_lock(&table_lock);
+  if(tables.empty() || tables.back()->size() < 2*m)
+  {
+    // built once for the largest span seen; exact angles instead of a recurrence
+    tables.push_back(new vector<float>(2*m, 0.0f));
+    vector<float> &table = *tables.back();
+    for(size_t half = 1; half < m; half <<= 1)
+    {
+      for(size_t j = 0; j < half; j++)
+      {
+        double angle = -dir * M_PI * (double)j / half;
+        table[2*(half + j)] = (float)cos(angle);
+        table[2*(half + j) + 1] = (float)sin(angle);
+      }
+    }
+  }
+  const float *table = &(*tables.back())[0];
+  pthread_mutex_unlock(&table_lock);
+  return table;
+}
+
+// a[k+j], a[k+j+half] for j in [j0, j1) with twiddles w[j]
+static inline void butterflies(float *a, float *b, const float *w, size_t j0, size_t j1)
+{
+  size_t j = j0;
+#ifdef __SSE2__
+  const __m128 sign = _mm_set_ps(1.0f, -1.0f, 1.0f, -1.0f);
+  for(; j + 2 <= j1; j += 2)
+  {
+    __m128 tw = _mm_loadu_ps(w + 2*j);
+    __m128 v = _mm_loadu_ps(b + 2*j);
+    __m128 u = _mm_loadu_ps(a + 2*j);
+    __m128 wr = _mm_shuffle_ps(tw, tw, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128 wi = _mm_shuffle_ps(tw, tw, _MM_SHUFFLE(3, 3, 1, 1));
+    __m128 vs = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 t = _mm_add_ps(_mm_mul_ps(v, wr), _mm_mul_ps(_mm_mul_ps(vs, wi), sign));
+    _mm_storeu_ps(a + 2*j, _mm_add_ps(u, t));
+    _mm_storeu_ps(b + 2*j, _mm_sub_ps(u, t));
+  }
+#endif
+  for(; j < j1; j++)
+  {
+    float tr = w[2*j] * b[2*j] - w[2*j+1] * b[2*j+1];
+    float ti = w[2*j] * b[2*j+1] + w[2*j+1] * b[2*j];
+    float ur = a[2*j], ui = a[2*j+1];
+    a[2*j] = ur + tr;
+    a[2*j+1] = ui + ti;
+    b[2*j] = ur - tr;
+    b[2*j+1] = ui - ti;
+  }
+}
+
+struct StageJob
+{
+    float *data;
+    const float *table;
+    size_t span;        // block size handled per unit (blocked mode)
+    int first_stage;
+    int last_stage;
+};
+
+// blocked mode: each unit is a whole block of 2^(last_stage+1) points run through every stage
+static void runBlocks(void *arg, size_t first, size_t last)
+{
+  StageJob *job = (StageJob *)arg;
+  for(size_t blk = first; blk < last; blk++)
+  {
+    float *base = job->data + 2 * blk * job->span;
+    for(int s = job->first_stage; s <= job->last_stage; s++)
+    {
+      size_t half = (size_t)1 << s;
+      const float *w = job->table + 2*half;
+      for(size_t k = 0; k < job->span; k += 2*half)
+        butterflies(base + 2*k, base + 2*(k + half), w, 0, half);
+    }
+  }
+}
+
+// striped mode: each unit is one butterfly of a single stage, for stages wider than a thread's share
+static void runStripe(void *arg, size_t first, size_t last)
+{
+  StageJob *job = (StageJob *)arg;
+  size_t half = (size_t)1 << job->first_stage;
+  const float *w = job->table + 2*half;
+  while(first < last)
+  {
+    size_t k = (first / half) * 2 * half;
+    size_t j0 = first % half;
+    size_t j1 = (last - first < half - j0) ? j0 + (last - first) : half;
+    butterflies(job->data + 2*k, job->data + 2*(k + half), w, j0, j1);
+    first += j1 - j0;
+  }
+}
+
+void CpuEngine::stages(cl_float2 *buf, size_t begin, size_t end, int first_stage, int last_stage, int dir)
+{
+  if(first_stage > last_stage || end <= begin)
+    return;
+
+  StageJob job;
+  job.data = (float *)(buf + begin);
+  job.table = twiddles((size_t)2 << last_stage, dir);
+  job.span = (size_t)2 << last_stage;
+  job.first_stage = first_stage;
+  job.last_stage = last_stage;
+
+  size_t blocks = (end - begin) / job.span;
+  if(blocks >= (size_t)num_threads)
+  {
+    parallelFor(blocks, runBlocks, &job);
+    return;
+  }
+
+  // too few blocks to go around: split each stage's butterflies instead
+  for(int s = first_stage; s <= last_stage; s++)
+  {
+    job.first_stage = s;
+    parallelFor((end - begin) / 2, runStripe, &job);
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef _CPUENGINE_H_
+#define _CPUENGINE_H_
+
+#include <oclUtils.h>
+#include <pthread.h>
+#include <vector>
+
+/* Pool of worker threads running radix-2 decimation-in-time butterfly stages
+   on interleaved float complex data (the cl_float2 layout) with SSE2. */
+class CpuEngine
+{
+    public:
+        /* num_threads = 0 uses one thread per online core. */
+        CpuEngine(int num_threads = 0);
+        ~CpuEngine();
+
+        /* Process wide engine with one thread per online core, created on first use. */
+        static CpuEngine &shared();
+
+        int numThreads() const { return num_threads; }
+
+        /* Runs stages first_stage..last_stage (span 2^(s+1)) on buf[begin, end).
+           end - begin must be a multiple of 2^(last_stage+1). dir is 1 forward, -1 inverse. */
+        void stages(cl_float2 *buf, size_t begin, size_t end, int first_stage, int last_stage, int dir);
+
+        /* Splits [0, count) into one contiguous range per thread and calls fn on each.
+           Safe to call from several threads: while one caller owns the pool the
+           others run their whole job on their own thread instead of waiting. */
+        void parallelFor(size_t count, void (*fn)(void *arg, size_t first, size_t last), void *arg);
+
+        /* Twiddles of the stage with span m: entry j < m/2 is at [2*(m/2 + j)], interleaved.
+           A returned table stays valid for the engine's lifetime, even after a larger one is built. */
+        const float *twiddles(size_t m, int dir);
+
+    private:
+        int num_threads;
+        std::vector<pthread_t> workers;
+        pthread_mutex_t lock;
+        pthread_mutex_t submit;         /* held by the thread whose job the pool is running */
+        pthread_mutex_t table_lock;
+        pthread_cond_t work_ready;
+        pthread_cond_t work_done;
+        unsigned long generation;
+        int pending;
+        bool shutting_down;
+
+        void (*job_fn)(void *, size_t, size_t);
+        void *job_arg;
+        size_t job_count;
+
+        /* every table built so far, the largest last; older ones are kept for callers still using them */
+        std::vector<std::vector<float> *> forward_tables;
+        std::vector<std::vector<float> *> inverse_tables;
+
+        static void *workerMain(void *arg);
+        void runShare(int thread);
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "DevicePlan.h"
+#include "oclFFT.h"
+#include <cstdlib>
+
+using namespace std;
+
+DevicePlan::DevicePlan(cl_context cxContext, cl_device_id cdDevice, cl_program cpProgram,
+                       const LaunchConfig& config, size_t n, size_t point_size)
+    : cxContext(cxContext), cdDevice(cdDevice), cpProgram(cpProgram), config(config), n(n), point_size(point_size)
+{
+  clRetainContext(cxContext);
+  clRetainProgram(cpProgram);
+  // no key destructor: a thread's resources are released with the plan, not when the thread exits
+  pthread_key_create(&key, NULL);
+  pthread_mutex_init(&lock, NULL);
+}
+
+DevicePlan::~DevicePlan()
+{
+  for(size_t i = 0; i < created.size(); i++)
+  {
+    DeviceResources *r = created[i];
+    clReleaseKernel(r->ckKernel);
+    clReleaseMemObject(r->cmDev);
+    clReleaseMemObject(r->cmPointsPerGroup);
+    clReleaseMemObject(r->cmDir);
+    clReleaseCommandQueue(r->cqCommandQueue);
+    delete r;
+  }
+  pthread_mutex_destroy(&lock);
+  pthread_key_delete(key);
+  clReleaseProgram(cpProgram);
+  clReleaseContext(cxContext);
+}
+
+const DeviceResources& DevicePlan::resources(int argc, const char **argv) const
+{
+  DeviceResources *r = (DeviceResources *)pthread_getspecific(key);
+  if(r == NULL)
+  {
+    r = create(argc, argv);
+    pthread_setspecific(key, r);
+  }
+  return *r;
+}
+
+DeviceResources *DevicePlan::create(int argc, const char **argv) const
+{
+  cl_int ciErr;
+  DeviceResources *r = new DeviceResources;
+
+  r->cqCommandQueue = clCreateCommandQueue(cxContext, cdDevice, 0, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateCommandQueue, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  r->cmDev = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, point_size * n, NULL, &ciErr);
+  if (ciErr == CL_SUCCESS)
+    r->cmPointsPerGroup = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &ciErr);
+  if (ciErr == CL_SUCCESS)
+    r->cmDir = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_int), NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // a kernel object per thread: clSetKernelArg on a shared one would race
+  r->ckKernel = clCreateKernel(cpProgram, groupKernelName(config.radix).c_str(), &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  cl_mem cmNoDebug = NULL;
+  ciErr = clSetKernelArg(r->ckKernel, 0, sizeof(cl_mem), (void *)&r->cmDev);
+  ciErr |= clSetKernelArg(r->ckKernel, 1, config.local_mem_size, NULL);
+  ciErr |= clSetKernelArg(r->ckKernel, 2, sizeof(cl_mem), (void *)&r->cmPointsPerGroup);
+  ciErr |= clSetKernelArg(r->ckKernel, 3, sizeof(cl_mem), (void *)&cmNoDebug);
+  ciErr |= clSetKernelArg(r->ckKernel, 4, sizeof(cl_mem), (void *)&r->cmDir);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  pthread_mutex_lock(&lock);
+  created.push_back(r);
+  pthread_mutex_unlock(&lock);
+  return r;
+}
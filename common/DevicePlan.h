@@ -0,0 +1,54 @@
+#ifndef _DEVICEPLAN_H_
+#define _DEVICEPLAN_H_
+
+#include <oclUtils.h>
+#include <pthread.h>
+#include <vector>
+#include "Tuner.h"
+
+/* What one thread needs to run the in-group kernel of a plan: its own queue,
+   its own kernel object with the arguments already set, and its own buffers. */
+struct DeviceResources
+{
+    cl_command_queue cqCommandQueue;
+    cl_kernel ckKernel;
+    cl_mem cmDev;               /* n points of the plan's point size */
+    cl_mem cmPointsPerGroup;
+    cl_mem cmDir;
+};
+
+/* An n-point transform on one device, fixed at creation: context, program and
+   launch configuration never change afterwards, so one plan can be shared by any
+   number of threads without locking. Each thread gets its own DeviceResources the
+   first time it asks; they live until the plan is destroyed. */
+class DevicePlan
+{
+    public:
+        /* cpProgram must have been built for cdDevice with the kernel of config.radix
+           (groupKernelName). point_size is sizeof(FFTPrecision<T>::Complex2). */
+        DevicePlan(cl_context cxContext, cl_device_id cdDevice, cl_program cpProgram,
+                   const LaunchConfig& config, size_t n, size_t point_size);
+        ~DevicePlan();
+
+        /* The calling thread's resources, created on its first call. */
+        const DeviceResources& resources(int argc, const char **argv) const;
+        const LaunchConfig& launchConfig() const { return config; }
+        size_t size() const { return n; }
+
+    private:
+        cl_context cxContext;
+        cl_device_id cdDevice;
+        cl_program cpProgram;
+        LaunchConfig config;
+        size_t n;
+        size_t point_size;
+        pthread_key_t key;
+        mutable pthread_mutex_t lock;   /* only taken when a thread creates its resources */
+        mutable std::vector<DeviceResources *> created;
+
+        DeviceResources *create(int argc, const char **argv) const;
+        DevicePlan(const DevicePlan&);
+        DevicePlan& operator=(const DevicePlan&);
+};
+
+#endif
@@ -0,0 +1,763 @@
+#include "FFT.h"
+#include "Trace.h"
+#include "oclFFT.h"
+#include "Scheduler.h"
+#include "DevicePlan.h"
+#include "CpuEngine.h"
+#include <vector>
+#include <deque>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <ctime>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#define PI 3.14159265358979323846
+#define TAIL_CHUNKS 8
+
+using namespace std;
+
+bool supportsDouble(cl_device_id cdDevice)
+{
+  size_t size = 0;
+  if(clGetDeviceInfo(cdDevice, CL_DEVICE_EXTENSIONS, 0, NULL, &size) != CL_SUCCESS || size == 0)
+    return false;
+  vector<char> extensions(size + 1, '\0');
+  clGetDeviceInfo(cdDevice, CL_DEVICE_EXTENSIONS, size, &extensions[0], NULL);
+  return strstr(&extensions[0], "cl_khr_fp64") != NULL;
+}
+
+static double getwalltime(void)
+{
+  struct timeval tim;
+  gettimeofday(&tim, NULL);
+  return (double)tim.tv_sec*1000000 + (double)tim.tv_usec;
+}
+
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+static double getcputime(void)
+{
+  struct timeval tim;
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  tim=ru.ru_utime;
+  double t=(double)tim.tv_sec*1000000 + (double)tim.tv_usec;
+  tim=ru.ru_stime;
+  t+=(double)tim.tv_sec*1000000 + (double)tim.tv_usec;
+  return t;
+}
+#endif
+
+// Host radix-2 stages over device-layout points. float goes to the threaded SSE
+// engine; double keeps its precision with a plain loop, one twiddle per j.
+static void hostStages(cl_float2 *buf, size_t begin, size_t end, int first_stage, int last_stage, int dir)
+{
+  CpuEngine::shared().stages(buf, begin, end, first_stage, last_stage, dir);
+}
+
+static void hostStages(cl_double2 *buf, size_t begin, size_t end, int first_stage, int last_stage, int dir)
+{
+  for(int s = first_stage; s <= last_stage; s++)
+  {
+    size_t half = (size_t)1 << s;
+    for(size_t j = 0; j < half; j++)
+    {
+      double angle = -dir * M_PI * j / half;
+      double wr = cos(angle), wi = sin(angle);
+      for(size_t k = begin + j; k < end; k += half << 1)
+      {
+        cl_double2 &u = buf[k];
+        cl_double2 &v = buf[k + half];
+        double tr = wr * v.x - wi * v.y;
+        double ti = wr * v.y + wi * v.x;
+        v.x = u.x - tr;
+        v.y = u.y - ti;
+        u.x += tr;
+        u.y += ti;
+      }
+    }
+  }
+}
+
+template <typename T>
+FFT<T>::FFT(int n, bool inverse)
+    : n(n), inverse(inverse)
+{
+    lgN = 0;
+    for (int i = n; i > 1; i >>= 1)
+    {
+        ++lgN;
+        assert((i & 1) == 0);
+    }
+    // every twiddle from its own angle in double: a running product per stage
+    // loses about one bit per step and dominates the error at large n
+    omega.resize(n / 2);
+    double sign = inverse ? 2.0 : -2.0;
+    for (int k = 0; k < n / 2; ++k)
+    {
+        double angle = sign * PI * k / n;
+        omega[k] = Complex((T)cos(angle), (T)sin(angle));
+    }
+}
+
+template <typename T>
+std::vector<typename FFT<T>::Complex> FFT<T>::transform(const vector<Complex>& buf) const
+{
+    // per call, so one plan can serve several threads
+    vector<Complex> result(n);
+    bitReverseCopy(buf, result);
+
+    int m = 1;
+
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+    double start_t = getcputime();
+#endif
+    for (int s = 0; s < lgN; ++s)
+    {
+        m <<= 1;
+        int stride = n / m;
+        for (int k = 0; k < n; k += m)
+        {
+            for (int j = 0; j < (m >> 1); ++j)
+            {
+                Complex t = omega[j * stride] * result[k + j + (m >> 1)];
+                Complex u = result[k + j];
+                result[k + j] = u + t;
+                result[k + j + (m >> 1)] = u - t;
+            }
+        }
+#if FFT_TRACE_LEVEL >= FFT_TRACE_STAGES
+        for (int i = 0; i < n; i++)
+            shrLog("Index %d: (after) (s:%d) %f %f\n", i, s, (double)real(result[i]), (double)imag(result[i]));
+#endif
+    }
+
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+    double clock_diff = getcputime() - start_t;
+#endif
+    TRACE_TIMING(("CPU transform diff microseconds\t %5.2f \n", clock_diff));
+
+    if (inverse == false)
+        for (int i = 0; i < n; ++i)
+            result[i] /= (T)n;
+
+    return result;
+}
+
+template <typename T>
+void FFT<T>::upload(const vector<Complex>& buf, Complex2 * cl_complex_buf) const
+{
+  for(int i = 0; i < n; i++)
+  {
+    int index = i, rev = 0;
+    for(int j = 0; j < lgN; ++j)
+    {
+      rev = (rev << 1) | (index & 1);
+      index >>= 1;
+    }
+    cl_complex_buf[rev].x = real(buf[i]);
+    cl_complex_buf[rev].y = imag(buf[i]);
+  }
+}
+
+template <typename T>
+void FFT<T>::scale(Complex2 * cl_complex_buf) const
+{
+  if(inverse == false)
+  {
+    for(int i = 0; i < n; ++i)
+    {
+      cl_complex_buf[i].x = cl_complex_buf[i].x / n;
+      cl_complex_buf[i].y = cl_complex_buf[i].y / n;
+    }
+  }
+}
+
+// The debug buffer only exists from FFT_TRACE_DEBUG up; below that cl_debug_buf
+// and cmDebug may be NULL and nothing is transferred. Callers sharing a plan
+// across threads pass NULL at every level.
+template <typename T>
+void FFT<T>::traceDebugUpload(void * cl_debug_buf, cl_mem cmDebug, cl_command_queue cqCommandQueue,
+                              int argc, const char **argv) const
+{
+#if FFT_TRACE_LEVEL >= FFT_TRACE_DEBUG
+  if(cmDebug == NULL)
+    return;
+  Complex2 * cl_complex_debug_buf = (Complex2 *)cl_debug_buf;
+  for(int i = 0; i < n; i++)
+  {
+    cl_complex_debug_buf[i].x = -1.0;
+    cl_complex_debug_buf[i].y = -1.0;
+  }
+
+  cl_int ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmDebug, CL_FALSE, 0, sizeof(Complex2) * n, cl_debug_buf, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+#else
+  (void)cl_debug_buf; (void)cmDebug; (void)cqCommandQueue; (void)argc; (void)argv;
+#endif
+}
+
+template <typename T>
+void FFT<T>::traceDebugDownload(void * cl_debug_buf, cl_mem cmDebug, cl_command_queue cqCommandQueue,
+                                int argc, const char **argv) const
+{
+#if FFT_TRACE_LEVEL >= FFT_TRACE_DEBUG
+  if(cmDebug == NULL)
+    return;
+  cl_int ciErr = clEnqueueReadBuffer(cqCommandQueue, cmDebug, CL_TRUE, 0, sizeof(Complex2) * n, cl_debug_buf, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  Complex2 * cl_complex_debug_buf = (Complex2 *)cl_debug_buf;
+  for(int i = 0; i < n; i++)
+    shrLog("Index %d: (debug) %f %f\n", i, (double)cl_complex_debug_buf[i].x, (double)cl_complex_debug_buf[i].y);
+#else
+  (void)cl_debug_buf; (void)cmDebug; (void)cqCommandQueue; (void)argc; (void)argv;
+#endif
+}
+
+template <typename T>
+void FFT<T>::transformGPU(const vector<Complex>& buf, void * cl_buf, void * cl_debug_buf, cl_mem cmDev,
+                          cl_mem cmPointsPerGroup, cl_mem cmDebug, cl_mem cmDir, cl_kernel ckKernel,
+                          size_t szGlobalWorkSize, size_t szLocalWorkSize, unsigned int points_per_group,
+                          cl_command_queue cqCommandQueue, cl_int ciErr, int argc, const char **argv,
+                          const TailSplit * split) const
+{
+  int dir_i = (inverse) ? -1 : 1;
+  void * dir = (void *)&dir_i;
+  void * pts_per_grp_p = (void *)&points_per_group;
+  Complex2 * cl_complex_buf = (Complex2 *)cl_buf;
+  upload(buf, cl_complex_buf);
+  traceDebugUpload(cl_debug_buf, cmDebug, cqCommandQueue, argc, argv);
+
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmDev, CL_FALSE, 0, sizeof(Complex2) * n, cl_buf, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmPointsPerGroup, CL_FALSE, 0, sizeof(cl_uint), pts_per_grp_p, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmDir, CL_FALSE, 0, sizeof(cl_int), dir, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+  double start_t = getwalltime();
+#endif
+
+  ciErr = clEnqueueNDRangeKernel(cqCommandQueue, ckKernel, 1, NULL, &szGlobalWorkSize, &szLocalWorkSize, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    shrLog("Error is %s\n", oclErrorString(ciErr));
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // the cross-group stages: a share on the device if a cost model says so, the rest
+  // on the host, overlapped with the download chunk by chunk
+  int first_host_stage = log2(points_per_group);
+  if(split != NULL && n > (int)points_per_group)
+  {
+    int chunk_stages = log2(tailChunk(points_per_group)) - first_host_stage;
+    int device_stages = split->model.chooseDeviceStages(lgN - first_host_stage, chunk_stages);
+    TRACE_TIMING(("Cross-group stages: %d on the device, %d on the host\n", device_stages, lgN - first_host_stage - device_stages));
+    enqueueDeviceStages(*split, first_host_stage, device_stages, szGlobalWorkSize, szLocalWorkSize,
+                        cqCommandQueue, argc, argv);
+    first_host_stage += device_stages;
+  }
+  downloadAndCombine(cl_complex_buf, cmDev, points_per_group, first_host_stage, cqCommandQueue, argc, argv);
+
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+  double clock_diff = getwalltime() - start_t;
+#endif
+  TRACE_TIMING(("GPU transform diff microseconds\t %5.2f \n", clock_diff));
+
+  traceDebugDownload(cl_debug_buf, cmDebug, cqCommandQueue, argc, argv);
+
+  scale(cl_complex_buf);
+}
+
+template <typename T>
+void FFT<T>::transformGPU(const vector<Complex>& buf, void * cl_buf, const DevicePlan& plan,
+                          int argc, const char **argv) const
+{
+  assert(plan.size() == (size_t)n);
+  const DeviceResources& r = plan.resources(argc, argv);
+  const LaunchConfig& config = plan.launchConfig();
+  transformGPU(buf, cl_buf, NULL, r.cmDev, r.cmPointsPerGroup, NULL, r.cmDir, r.ckKernel,
+               config.szGlobalWorkSize, config.szLocalWorkSize, config.points_per_group,
+               r.cqCommandQueue, CL_SUCCESS, argc, argv);
+}
+
+template <typename T>
+void FFT<T>::transformAsync(const vector<Complex>& buf, void * cl_buf, const DevicePlan& plan,
+                            FFTRequest& request, int argc, const char **argv,
+                            FFTCallback callback, void *user_data) const
+{
+  assert(plan.size() == (size_t)n);
+  assert(request.ready());
+  const DeviceResources& r = plan.resources(argc, argv);
+  const LaunchConfig& config = plan.launchConfig();
+  cl_int ciErr;
+
+  pthread_mutex_lock(&request.lock);
+  request.pending = true;
+  request.done = false;
+  request.status = CL_SUCCESS;
+  pthread_mutex_unlock(&request.lock);
+  request.device_status = CL_SUCCESS;
+  request.finish = finishAsync;
+  request.dir = (inverse) ? -1 : 1;
+  request.points_per_group = config.points_per_group;
+  request.fft = this;
+  request.cl_buf = cl_buf;
+  request.callback = callback;
+  request.user_data = user_data;
+
+  Complex2 * cl_complex_buf = (Complex2 *)cl_buf;
+  upload(buf, cl_complex_buf);
+
+  // all non-blocking: the in-order queue serializes this request behind earlier ones on the same thread
+  ciErr = clEnqueueWriteBuffer(r.cqCommandQueue, r.cmDev, CL_FALSE, 0, sizeof(Complex2) * n, cl_buf, 0, NULL, NULL);
+  ciErr |= clEnqueueWriteBuffer(r.cqCommandQueue, r.cmPointsPerGroup, CL_FALSE, 0, sizeof(cl_uint), &request.points_per_group, 0, NULL, NULL);
+  ciErr |= clEnqueueWriteBuffer(r.cqCommandQueue, r.cmDir, CL_FALSE, 0, sizeof(cl_int), &request.dir, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  size_t szGlobalWorkSize = config.szGlobalWorkSize;
+  size_t szLocalWorkSize = config.szLocalWorkSize;
+  ciErr = clEnqueueNDRangeKernel(r.cqCommandQueue, r.ckKernel, 1, NULL, &szGlobalWorkSize, &szLocalWorkSize, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    shrLog("Error is %s\n", oclErrorString(ciErr));
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  cl_event read_done;
+  ciErr = clEnqueueReadBuffer(r.cqCommandQueue, r.cmDev, CL_FALSE, 0, sizeof(Complex2) * n, cl_buf, 0, NULL, &read_done);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  ciErr = clSetEventCallback(read_done, CL_COMPLETE, FFTRequest::deviceDone, &request);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetEventCallback, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  // the callback holds its own reference to the event
+  clReleaseEvent(read_done);
+  clFlush(r.cqCommandQueue);
+}
+
+template <typename T>
+void FFT<T>::finishAsync(FFTRequest *req)
+{
+  cl_int status = req->device_status;
+  if(status == CL_SUCCESS)
+  {
+    const FFT<T> *fft = (const FFT<T> *)req->fft;
+    Complex2 * cl_complex_buf = (Complex2 *)req->cl_buf;
+    fft->combineGroups(cl_complex_buf, req->points_per_group);
+    fft->scale(cl_complex_buf);
+  }
+  if(req->callback != NULL)
+    req->callback(req->cl_buf, status, req->user_data);
+  req->complete(status);
+}
+
+// Requests whose download is in, waiting for the finisher thread. One thread for the
+// process, started with the first request: the host stages already spread over the
+// CpuEngine pool, so more finishers would only contend for it.
+static pthread_once_t finisher_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t finisher_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t finisher_ready = PTHREAD_COND_INITIALIZER;
+static deque<FFTRequest *> finisher_queue;
+
+void CL_CALLBACK FFTRequest::deviceDone(cl_event, cl_int status, void *request)
+{
+  FFTRequest *req = (FFTRequest *)request;
+  req->device_status = status;
+  pthread_once(&finisher_once, startFinisher);
+  pthread_mutex_lock(&finisher_lock);
+  finisher_queue.push_back(req);
+  pthread_cond_signal(&finisher_ready);
+  pthread_mutex_unlock(&finisher_lock);
+}
+
+void FFTRequest::startFinisher()
+{
+  pthread_t thread;
+  if(pthread_create(&thread, NULL, finisherMain, NULL) != 0)
+  {
+    shrLog("Error in pthread_create, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    exit(EXIT_FAILURE);
+  }
+  pthread_detach(thread);
+}
+
+void *FFTRequest::finisherMain(void *)
+{
+  for(;;)
+  {
+    pthread_mutex_lock(&finisher_lock);
+    while(finisher_queue.empty())
+      pthread_cond_wait(&finisher_ready, &finisher_lock);
+    FFTRequest *req = finisher_queue.front();
+    finisher_queue.pop_front();
+    pthread_mutex_unlock(&finisher_lock);
+    req->finish(req);
+  }
+  return NULL;
+}
+
+FFTRequest::FFTRequest()
+    : pending(false), done(false), status(CL_SUCCESS), device_status(CL_SUCCESS), finish(NULL),
+      dir(1), points_per_group(0), fft(NULL), cl_buf(NULL), callback(NULL), user_data(NULL)
+{
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&finished, NULL);
+}
+
+FFTRequest::~FFTRequest()
+{
+  wait();
+  pthread_cond_destroy(&finished);
+  pthread_mutex_destroy(&lock);
+}
+
+cl_int FFTRequest::wait()
+{
+  pthread_mutex_lock(&lock);
+  while(pending && !done)
+    pthread_cond_wait(&finished, &lock);
+  pending = false;
+  cl_int result = status;
+  pthread_mutex_unlock(&lock);
+  return result;
+}
+
+bool FFTRequest::ready()
+{
+  pthread_mutex_lock(&lock);
+  bool result = !pending || done;
+  pthread_mutex_unlock(&lock);
+  return result;
+}
+
+void FFTRequest::complete(cl_int result)
+{
+  pthread_mutex_lock(&lock);
+  status = result;
+  done = true;
+  pthread_cond_broadcast(&finished);
+  pthread_mutex_unlock(&lock);
+}
+
+template <typename T>
+void FFT<T>::transformMultiGPU(const vector<Complex>& buf, void * cl_buf, Scheduler &scheduler,
+                               int argc, const char **argv) const
+{
+  assert(scheduler.pointSize() == sizeof(Complex2));
+  int dir_i = (inverse) ? -1 : 1;
+  Complex2 * cl_complex_buf = (Complex2 *)cl_buf;
+  upload(buf, cl_complex_buf);
+
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+  double start_t = getwalltime();
+#endif
+
+  // the devices each transform a share of the groups in place, the host merges them
+  scheduler.transformGroups(cl_complex_buf, n, dir_i, argc, argv);
+  combineGroups(cl_complex_buf, scheduler.pointsPerGroup());
+
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+  double clock_diff = getwalltime() - start_t;
+#endif
+  TRACE_TIMING(("MultiGPU transform diff microseconds\t %5.2f \n", clock_diff));
+
+  scale(cl_complex_buf);
+}
+
+template <typename T>
+void FFT<T>::combineGroups(Complex2 * cl_complex_buf, unsigned int points_per_group) const
+{
+  if(n <= (int)points_per_group)
+    return;
+
+  hostStages(cl_complex_buf, 0, n, log2(points_per_group), lgN - 1, inverse ? -1 : 1);
+}
+
+template <typename T>
+size_t FFT<T>::tailChunk(unsigned int points_per_group) const
+{
+  size_t chunk = n / TAIL_CHUNKS;
+  if(chunk < points_per_group)
+    chunk = points_per_group;
+  return chunk < (size_t)n ? chunk : n;
+}
+
+template <typename T>
+void FFT<T>::downloadAndCombine(Complex2 * cl_complex_buf, cl_mem cmDev, unsigned int points_per_group, int first_stage,
+                                cl_command_queue cqCommandQueue, int argc, const char **argv) const
+{
+  cl_int ciErr;
+  int dir = inverse ? -1 : 1;
+  size_t chunk = tailChunk(points_per_group);
+  int lg_chunk = log2(chunk);
+  size_t num_chunks = n / chunk;
+
+  // queue every chunk's read up front so the transfers run back to back
+  vector<cl_event> chunk_read(num_chunks);
+  for(size_t c = 0; c < num_chunks; c++)
+  {
+    ciErr = clEnqueueReadBuffer(cqCommandQueue, cmDev, CL_FALSE, sizeof(Complex2) * c * chunk, sizeof(Complex2) * chunk,
+                                cl_complex_buf + c * chunk, 0, NULL, &chunk_read[c]);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+  }
+  clFlush(cqCommandQueue);
+
+  // stages that stay inside a chunk run as soon as it lands
+  for(size_t c = 0; c < num_chunks; c++)
+  {
+    clWaitForEvents(1, &chunk_read[c]);
+    clReleaseEvent(chunk_read[c]);
+    hostStages(cl_complex_buf, c * chunk, (c + 1) * chunk, first_stage, lg_chunk - 1, dir);
+  }
+
+  hostStages(cl_complex_buf, 0, n, first_stage > lg_chunk ? first_stage : lg_chunk, lgN - 1, dir);
+}
+
+template <typename T>
+void FFT<T>::enqueueDeviceStages(const TailSplit& split, int first_stage, int num_stages, size_t szGlobalWorkSize,
+                                 size_t szLocalWorkSize, cl_command_queue cqCommandQueue, int argc, const char **argv) const
+{
+  cl_int ciErr;
+  // one m per stage, kept alive until the queue has consumed the non-blocking writes
+  vector<cl_uint> m(num_stages);
+  for(int i = 0; i < num_stages; i++)
+  {
+    m[i] = 2u << (first_stage + i);
+    ciErr = clEnqueueWriteBuffer(cqCommandQueue, split.cmM, CL_FALSE, 0, sizeof(cl_uint), &m[i], 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    ciErr = clEnqueueNDRangeKernel(cqCommandQueue, split.ckKernelAll, 1, NULL, &szGlobalWorkSize, &szLocalWorkSize, 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      shrLog("Error is %s\n", oclErrorString(ciErr));
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+  }
+  if(num_stages > 0)
+    clFinish(cqCommandQueue);
+}
+
+int TailCostModel::chooseDeviceStages(int tail_stages, int chunk_stages) const
+{
+  int best = 0;
+  double best_us = -1.0;
+  for(int d = 0; d <= tail_stages; d++)
+  {
+    // host stages that fit in a chunk hide behind the download, the rest don't
+    int overlapped = chunk_stages - d > 0 ? chunk_stages - d : 0;
+    if(overlapped > tail_stages - d)
+      overlapped = tail_stages - d;
+    int exposed = tail_stages - d - overlapped;
+    double overlapped_us = overlapped * host_stage_us;
+    double us = d * device_stage_us + (download_us > overlapped_us ? download_us : overlapped_us)
+              + exposed * host_stage_us;
+    if(best_us < 0.0 || us < best_us)
+    {
+      best_us = us;
+      best = d;
+    }
+  }
+  return best;
+}
+
+template <typename T>
+TailCostModel FFT<T>::calibrateTail(cl_mem cmDev, const TailSplit& split, size_t szGlobalWorkSize, size_t szLocalWorkSize,
+                                    unsigned int points_per_group, cl_command_queue cqCommandQueue, int argc, const char **argv) const
+{
+  TailCostModel model;
+  vector<Complex2> scratch(n);
+  int stage = log2(points_per_group) < lgN ? log2(points_per_group) : lgN - 1;
+
+  // device: one FFT2_ALL_POINTS stage, warm run first
+  enqueueDeviceStages(split, stage, 1, szGlobalWorkSize, szLocalWorkSize, cqCommandQueue, argc, argv);
+  double t = getwalltime();
+  enqueueDeviceStages(split, stage, 1, szGlobalWorkSize, szLocalWorkSize, cqCommandQueue, argc, argv);
+  model.device_stage_us = getwalltime() - t;
+
+  // download of all n points
+  t = getwalltime();
+  clEnqueueReadBuffer(cqCommandQueue, cmDev, CL_TRUE, 0, sizeof(Complex2) * n, &scratch[0], 0, NULL, NULL);
+  model.download_us = getwalltime() - t;
+
+  // host: the same stage, twiddles already built on the second run
+  hostStages(&scratch[0], 0, n, stage, stage, inverse ? -1 : 1);
+  t = getwalltime();
+  hostStages(&scratch[0], 0, n, stage, stage, inverse ? -1 : 1);
+  model.host_stage_us = getwalltime() - t;
+
+  TRACE_TIMING(("Tail cost model: device stage %5.2f us, host stage %5.2f us, download %5.2f us\n",
+                model.device_stage_us, model.host_stage_us, model.download_us));
+  return model;
+}
+
+template <typename T>
+void FFT<T>::transformAllGPU(const vector<Complex>& buf, void * cl_buf, void * cl_debug_buf, cl_mem cmDev, cl_mem cmM,
+                             cl_mem cmPointsPerGroup, cl_mem cmDebug, cl_mem cmDir, cl_kernel ckKernel, cl_kernel ckKernelAll,
+                             size_t szGlobalWorkSize, size_t szLocalWorkSize, unsigned int points_per_group,
+                             cl_command_queue cqCommandQueue, cl_int ciErr, int argc, const char **argv) const
+{
+  int dir_i = (inverse) ? -1 : 1;
+  void * dir = (void *)&dir_i;
+  void * pts_per_grp_p = (void *)&points_per_group;
+  Complex2 * cl_complex_buf = (Complex2 *)cl_buf;
+  upload(buf, cl_complex_buf);
+  traceDebugUpload(cl_debug_buf, cmDebug, cqCommandQueue, argc, argv);
+
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmDev, CL_FALSE, 0, sizeof(Complex2) * n, cl_buf, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmPointsPerGroup, CL_FALSE, 0, sizeof(cl_uint), pts_per_grp_p, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmDir, CL_FALSE, 0, sizeof(cl_int), dir, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+  double start_t = getcputime();
+#endif
+
+  ciErr = clEnqueueNDRangeKernel(cqCommandQueue, ckKernel, 1, NULL, &szGlobalWorkSize, &szLocalWorkSize, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    shrLog("Error is %s\n", oclErrorString(ciErr));
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  clFinish(cqCommandQueue);
+
+  // one more iteration to combine all the elements together
+  if(n > (int)points_per_group)
+  {
+    int m = points_per_group;
+
+    for(int s = log2(points_per_group); s < lgN; ++s)
+    {
+      m <<= 1;
+
+      ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmM, CL_FALSE, 0, sizeof(cl_uint), &m, 0, NULL, NULL);
+      if (ciErr != CL_SUCCESS)
+      {
+        shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+        Cleanup(argc, (char **)argv, EXIT_FAILURE);
+      }
+
+      ciErr = clEnqueueNDRangeKernel(cqCommandQueue, ckKernelAll, 1, NULL, &szGlobalWorkSize, &szLocalWorkSize, 0, NULL, NULL);
+      if (ciErr != CL_SUCCESS)
+      {
+        shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+        shrLog("Error is %s\n", oclErrorString(ciErr));
+        Cleanup(argc, (char **)argv, EXIT_FAILURE);
+      }
+      clFinish(cqCommandQueue);
+    }
+  }
+
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+  double clock_diff = getcputime() - start_t;
+#endif
+  TRACE_TIMING(("AllGPU transform diff microseconds\t %5.2f \n", clock_diff));
+
+  ciErr = clEnqueueReadBuffer(cqCommandQueue, cmDev, CL_TRUE, 0, sizeof(Complex2) * n, cl_buf, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  traceDebugDownload(cl_debug_buf, cmDebug, cqCommandQueue, argc, argv);
+
+  scale(cl_complex_buf);
+}
+
+template <typename T>
+T FFT<T>::getIntensity(Complex c)
+{
+    return abs(c);
+}
+
+template <typename T>
+T FFT<T>::getPhase(Complex c)
+{
+    return arg(c);
+}
+
+template <typename T>
+void FFT<T>::bitReverseCopy(const vector<Complex>& src, vector<Complex>& dest)
+        const
+{
+    for (int i = 0; i < n; ++i)
+    {
+        int index = i, rev = 0;
+        for (int j = 0; j < lgN; ++j)
+        {
+            rev = (rev << 1) | (index & 1);
+            index >>= 1;
+        }
+        dest[rev] = src[i];
+    }
+}
+
+// the two precisions the kernels are built for
+template class FFT<float>;
+template class FFT<double>;
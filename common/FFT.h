@@ -0,0 +1,183 @@
+#ifndef _FFT_H_
+#define _FFT_H_
+
+#include <oclUtils.h>
+#include <shrQATest.h>
+#include "Trace.h"
+#include <complex>
+#include <vector>
+#include <ctime>
+#include <pthread.h>
+
+class Scheduler;
+class DevicePlan;
+
+/* Measured costs of one cross-group stage over all n points, used to split
+   the stages after FFT2 between the device and the host engine. */
+struct TailCostModel
+{
+    double device_stage_us;   /* one FFT2_ALL_POINTS launch */
+    double host_stage_us;     /* one stage on the host engine */
+    double download_us;       /* reading all n points back */
+
+    /* Number of the tail_stages to run on the device before the download.
+       chunk_stages of them fit in one download chunk and can overlap it on the host. */
+    int chooseDeviceStages(int tail_stages, int chunk_stages) const;
+};
+
+/* Device side of the split: FFT2_ALL_POINTS with its arguments already set. */
+struct TailSplit
+{
+    cl_kernel ckKernelAll;
+    cl_mem cmM;
+    TailCostModel model;
+};
+
+/* True if cdDevice reports cl_khr_fp64 and can build the double precision kernels. */
+bool supportsDouble(cl_device_id cdDevice);
+
+/* Device side of each host precision: the vector type of the device buffers and
+   the FFT2.cl build options that select the matching kernels (trace level included). */
+template <typename T> struct FFTPrecision;
+
+template <> struct FFTPrecision<float>
+{
+    typedef cl_float2 Complex2;
+    static const char *buildOptions() { return FFT_TRACE_OPTIONS; }
+    static bool supported(cl_device_id) { return true; }
+};
+
+template <> struct FFTPrecision<double>
+{
+    typedef cl_double2 Complex2;
+    static const char *buildOptions() { return "-DFFT_DOUBLE " FFT_TRACE_OPTIONS; }
+    static bool supported(cl_device_id cdDevice) { return supportsDouble(cdDevice); }
+};
+
+/* Called once an asynchronous transform has finished, on the thread that runs the host
+   stages of every asynchronous request (never the OpenCL runtime's): a slow callback
+   delays the requests behind it. status is CL_SUCCESS or the error the transfer or
+   kernel failed with. */
+typedef void (*FFTCallback)(void *cl_buf, cl_int status, void *user_data);
+
+/* One transform started by FFT::transformAsync. It is owned by the caller, who must
+   keep it, and the cl_buf passed with it, alive until it completes: cl_buf is written
+   by the device and the host stages until then and must not be read or reused before.
+   The destructor waits for completion, so a request going out of scope is safe. */
+class FFTRequest
+{
+    public:
+        FFTRequest();
+        ~FFTRequest();
+
+        /* Blocks until the transform and its callback are done; returns its status. */
+        cl_int wait();
+        /* True once wait() would return immediately. */
+        bool ready();
+
+    private:
+        template <typename T> friend class FFT;
+
+        pthread_mutex_t lock;
+        pthread_cond_t finished;
+        /* pending, done and status change under lock only */
+        bool pending;
+        bool done;
+        cl_int status;
+        cl_int device_status;       /* of the download, handed to the finisher thread */
+        void (*finish)(FFTRequest *request);
+        /* read by the queued writes, so they live here rather than on the caller's stack */
+        cl_int dir;
+        cl_uint points_per_group;
+        const void *fft;
+        void *cl_buf;
+        FFTCallback callback;
+        void *user_data;
+
+        void complete(cl_int status);
+        /* clSetEventCallback hook of transformAsync's download: queues the request for
+           the finisher thread and returns, the runtime's callback thread never blocks. */
+        static void CL_CALLBACK deviceDone(cl_event, cl_int status, void *request);
+        static void startFinisher();
+        static void *finisherMain(void *arg);
+        FFTRequest(const FFTRequest&);
+        FFTRequest& operator=(const FFTRequest&);
+};
+
+/* Radix-2 FFT in precision T (float or double). The device buffers passed to the
+   GPU transforms hold FFTPrecision<T>::Complex2 points and the kernels must come
+   from FFT2.cl built with FFTPrecision<T>::buildOptions(). The debug buffers are
+   only touched from FFT_TRACE_DEBUG up and may be NULL below it (see Trace.h).
+   An FFT holds nothing but its size, direction and twiddles: every scratch buffer is
+   per call, so the transforms may run on one instance from several threads. */
+template <typename T>
+class FFT
+{
+    public:
+        typedef std::complex<T> Complex;
+        typedef typename FFTPrecision<T>::Complex2 Complex2;
+
+        /* Initializes FFT. n must be a power of 2. */
+        FFT(int n, bool inverse = false);
+        /* Computes Discrete Fourier Transform of given buffer. */
+        std::vector<Complex> transform(const std::vector<Complex>& buf) const;
+        void transformGPU(const std::vector<Complex>& buf, void * cl_buf, void * cl_debug_buf, cl_mem cmDev,
+                          cl_mem cmPointsPerGroup, cl_mem cmDebug, cl_mem cmDir, cl_kernel ckKernel,
+                          size_t szGlobalWorkSize, size_t szLocalWorkSize, unsigned int points_per_group,
+                          cl_command_queue cqCommandQueue, cl_int ciErr, int argc, const char **argv,
+                          const TailSplit * split = NULL) const;
+        /* transformGPU on the calling thread's queue, kernel and buffers of plan. Several
+           threads may share this FFT and the plan, each with its own cl_buf of n points. */
+        void transformGPU(const std::vector<Complex>& buf, void * cl_buf, const DevicePlan& plan,
+                          int argc, const char **argv) const;
+        /* Non-blocking transformGPU: queues the upload, the kernel and the download on the
+           calling thread's queue of plan and returns at once. The cross-group stages and the
+           scaling run when the download lands, then callback (if any) is called and request
+           becomes ready. buf is only read during the call; see FFTRequest for cl_buf.
+           Several requests may be in flight on one thread; they complete in order. */
+        void transformAsync(const std::vector<Complex>& buf, void * cl_buf, const DevicePlan& plan,
+                            FFTRequest& request, int argc, const char **argv,
+                            FFTCallback callback = NULL, void *user_data = NULL) const;
+        void transformAllGPU(const std::vector<Complex>& buf, void * cl_buf, void * cl_debug_buf, cl_mem cmDev, cl_mem cmM,
+                                  cl_mem cmPointsPerGroup, cl_mem cmDebug, cl_mem cmDir, cl_kernel ckKernel, cl_kernel ckKernelAll,
+                                  size_t szGlobalWorkSize, size_t szLocalWorkSize, unsigned int points_per_group,
+                                  cl_command_queue cqCommandQueue, cl_int ciErr, int argc, const char **argv) const;
+        /* Same as transformGPU, with the groups split across every device of the scheduler.
+           The scheduler must have been built for this precision. */
+        void transformMultiGPU(const std::vector<Complex>& buf, void * cl_buf, Scheduler &scheduler,
+                               int argc, const char **argv) const;
+        /* Times one cross-group stage on the device and on the host, and the download. */
+        TailCostModel calibrateTail(cl_mem cmDev, const TailSplit& split, size_t szGlobalWorkSize, size_t szLocalWorkSize,
+                                    unsigned int points_per_group, cl_command_queue cqCommandQueue, int argc, const char **argv) const;
+        static T getIntensity(Complex c);
+        static T getPhase(Complex c);
+
+    private:
+        int n, lgN;
+        bool inverse;
+        std::vector<Complex> omega;     /* the n/2 twiddles e^(-+2 pi i k/n) */
+
+        /* Bit reversed copy of buf into cl_buf, converted to the device type. */
+        void upload(const std::vector<Complex>& buf, Complex2 * cl_complex_buf) const;
+        /* The 1/n of the forward transform, applied on the host after the download. */
+        void scale(Complex2 * cl_complex_buf) const;
+        void traceDebugUpload(void * cl_debug_buf, cl_mem cmDebug, cl_command_queue cqCommandQueue,
+                              int argc, const char **argv) const;
+        void traceDebugDownload(void * cl_debug_buf, cl_mem cmDebug, cl_command_queue cqCommandQueue,
+                                int argc, const char **argv) const;
+        /* Host stages log2(points_per_group)..lgN that merge the groups' results. */
+        void combineGroups(Complex2 * cl_complex_buf, unsigned int points_per_group) const;
+        size_t tailChunk(unsigned int points_per_group) const;
+        /* Reads cmDev back in chunks, running the stages from first_stage on each chunk as it arrives. */
+        void downloadAndCombine(Complex2 * cl_complex_buf, cl_mem cmDev, unsigned int points_per_group, int first_stage,
+                                cl_command_queue cqCommandQueue, int argc, const char **argv) const;
+        void enqueueDeviceStages(const TailSplit& split, int first_stage, int num_stages, size_t szGlobalWorkSize,
+                                 size_t szLocalWorkSize, cl_command_queue cqCommandQueue, int argc, const char **argv) const;
+        /* Host side of an asynchronous request once its download is in: the cross-group
+           stages, the scaling and the user callback, on the finisher thread. */
+        static void finishAsync(FFTRequest *request);
+        void bitReverseCopy(const std::vector<Complex>& src,
+                std::vector<Complex>& dest) const;
+};
+
+#endif
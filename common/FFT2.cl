@@ -0,0 +1,268 @@
+#ifndef M_PI_F
+	#define M_PI_F M_PI
+#endif
+
+// FFT_DOUBLE builds the double precision variant, the host only sets it for
+// devices that report cl_khr_fp64
+#ifdef FFT_DOUBLE
+  #pragma OPENCL EXTENSION cl_khr_fp64 : enable
+  typedef double real;
+  typedef double2 real2;
+  typedef double4 real4;
+  #define M_PI_R M_PI
+#else
+  typedef float real;
+  typedef float2 real2;
+  typedef float4 real4;
+  #define M_PI_R M_PI_F
+#endif
+
+// TRACE_LEVEL comes from the host (Trace.h); from 2 up the kernels copy their
+// first-stage results to the debug buffer when one is bound. It may be NULL at any
+// level: DevicePlan binds none, so the copies are skipped for a NULL pointer
+#ifndef TRACE_LEVEL
+  #define TRACE_LEVEL 0
+#endif
+
+real2 mul_complex(real2 a, real2 b)
+{
+  return (real2)(a.s0*b.s0 - a.s1*b.s1,a.s0*b.s1 + a.s1*b.s0);
+}
+
+real2 exp_complex(real2 a)
+{
+  return (real2)(exp(a.s0)*cos(a.s1), exp(a.s0)*sin(a.s1));
+}
+
+// Coalesced copies between a group's ppg points in global memory and l, where
+// point p sits at p + (p >> pad_shift) (pad_shift 31: no padding). Work-item i
+// moves the real4 pairs i, i + local size, ..., so neighbouring items touch
+// neighbouring addresses; no pad ever falls between an even point and the next.
+void load_group(__global const real2 * a, __local real2 * l, uint ppg, uint pad_shift)
+{
+  __global const real4 * a4 = (__global const real4 *)a;
+  for(uint i = get_local_id(0); i < (ppg >> 1); i += get_local_size(0))
+  {
+    real4 v = a4[i];
+    uint p = (i << 1) + ((i << 1) >> pad_shift);
+    l[p] = v.s01;
+    l[p + 1] = v.s23;
+  }
+}
+
+void store_group(__global real2 * a, __local const real2 * l, uint ppg, uint pad_shift)
+{
+  __global real4 * a4 = (__global real4 *)a;
+  for(uint i = get_local_id(0); i < (ppg >> 1); i += get_local_size(0))
+  {
+    uint p = (i << 1) + ((i << 1) >> pad_shift);
+    a4[i] = (real4)(l[p], l[p + 1]);
+  }
+}
+
+__kernel void FFT2(__global real2 * a, __local real2 * l, __global const uint * points_per_group, __global real2 * debug, __global const int * dir)
+{
+  int points_per_item = *points_per_group/get_local_size(0);
+  int l_addr = get_local_id(0) * points_per_item;
+  int a_addr = get_group_id(0) * *points_per_group + l_addr;
+  int start_addr;  
+
+  real2 u;
+  real2 s;
+  real2 v;
+  real2 t;
+
+  real2 sumus;
+  real2 diffus;
+  real2 sumvt;
+  real2 diffvt;
+
+  real2 omega;
+  int angle;
+
+  // bring the group's points in coalesced, then each item takes its own run from local memory
+  load_group(a + get_group_id(0) * *points_per_group, l, *points_per_group, 31);
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // perform a 4-point FFT
+  for(int i = 0; i < points_per_item; i+=4)
+  {
+    u = l[l_addr];
+    s = l[l_addr+1];
+    v = l[l_addr+2];
+    t = l[l_addr+3];
+  
+    sumus = u + s;
+    diffus = u - s;
+    sumvt = v + t;
+    diffvt = (real2)(v.s1 - t.s1, t.s0 - v.s0) * (*dir);
+    l[l_addr] = sumus + sumvt;
+    l[l_addr+1] = diffus + diffvt;
+    l[l_addr+2] = sumus - sumvt;
+    l[l_addr+3] = diffus - diffvt;
+    l_addr += 4;
+  }
+
+  l_addr = get_local_id(0) * points_per_item;
+  a_addr = get_group_id(0) * *points_per_group + l_addr;
+
+#if TRACE_LEVEL >= 2
+  if(debug != 0)
+  {
+    for(int i = 0; i < points_per_item; i++)
+    {
+      debug[a_addr + i] = l[l_addr + i];
+    }
+  }
+#endif
+
+  // perform all other points necessary. we start at
+  // s = 2 since we have already done previos two stages
+  int m = 4;
+  int lgppi = (int)log2((float)points_per_item);
+  int lgppg = (int)log2((float)*points_per_group);
+
+  // stages that stay within the item's own points
+  for(int s = 2; s < lgppi; ++s)
+  {
+    m <<= 1;
+    for(int k = 0; k < points_per_item; k += m)
+    {
+      for(int j = 0; j < (m >> 1); ++j)
+      {
+        omega = exp_complex((real2)(0.0, (*dir) * - M_PI_R * j / (m >> 1)));
+        t = mul_complex(omega, l[l_addr + (m >> 1) + k + j]);
+        u = l[l_addr + k + j];
+        l[l_addr + k + j] = u + t;
+        l[l_addr + (m >> 1) + k + j] = u - t;
+      }
+    }
+  }
+  
+  barrier(CLK_LOCAL_MEM_FENCE); // synchronize all the threads
+
+  // stages across items: item i takes butterflies i*ppi/2 .. (i+1)*ppi/2 - 1, which sit
+  // in one half-block since m/2 >= ppi
+  for(int s = lgppi; s < lgppg ; ++s)
+  {
+    m <<= 1;
+    int first = get_local_id(0) * (points_per_item/2);
+    start_addr = first + (first / (m >> 1)) * (m >> 1);
+    angle = start_addr % m;
+    for(int j = start_addr; j < start_addr + points_per_item/2; ++j)
+    {
+      omega = exp_complex((real2)(0.0, (*dir) * - M_PI_R * angle / (m >> 1)));
+      t = mul_complex( omega, l[j + (m >> 1)]);
+      u = l[j];
+      l[j] = u + t;
+      l[j + (m >> 1)] = u - t;
+      angle++;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  store_group(a + get_group_id(0) * *points_per_group, l, *points_per_group, 31);
+}
+
+__kernel void FFT2_ALL_POINTS(__global real2 * a, __global const uint * m, __global const uint * points_per_group, __global const int * dir)
+{
+  int points_per_item = *points_per_group/get_local_size(0);
+  int butterflies = get_global_size(0) * (points_per_item/2);
+  int half = *m >> 1;
+  real2 omega;
+
+  real2 t;
+  real2 u;
+
+  // butterflies strided by the global size, so neighbouring items touch neighbouring points
+  for(int b = get_global_id(0); b < butterflies; b += get_global_size(0))
+  {
+    int j = b + (b / half) * half;
+    int angle = j % *m;
+    omega = exp_complex((real2)(0.0, (*dir) * - M_PI_R * angle / half));
+    t = mul_complex( omega, a[j + half]);
+    u = a[j];
+    a[j] = u + t;
+    a[j + half] = u - t;
+  }
+}
+
+// Register-blocked variant of FFT2: every work-item keeps 8 points in private
+// memory and runs up to three radix-2 stages on them (one radix-8 pass) before
+// the points go back through local memory, so a group of ppg points needs
+// ceil(log2(ppg)/3) local round trips and barriers instead of one per stage.
+// The group's points enter and leave through coalesced real4 accesses (see
+// load_group). The local size must be ppg/8 and l must hold ppg + ppg/8 points.
+
+// one pad slot every 8 points: the stride-8 scatter of the first pass and the
+// 8-point runs of the second land in distinct banks
+#define R8_PAD(p) ((p) + ((p) >> 3))
+
+// position in the group of point r of set k in a pass of rl stages starting at stage s
+uint r8_position(uint k, uint r, uint s, uint rl)
+{
+  return ((k >> s) << (s + rl)) + (k & ((1 << s) - 1)) + (r << s);
+}
+
+// stages s..s+rl-1 (rl <= 3) on the 8 points of x, which hold 8 >> rl sets of
+// 2^rl points; set c is set first_set + c of the pass
+void r8_pass(real2 * x, uint s, uint rl, uint first_set, int dir)
+{
+  uint mask = (1 << rl) - 1;
+  for(uint t = 0; t < 3; ++t)
+  {
+    if(t >= rl)
+      break;
+    uint half = 1 << t;
+    for(uint e = 0; e < 8; ++e)
+    {
+      uint r = e & mask;
+      if(r & half)
+        continue;
+      // index of the butterfly in its block of 2^(s+t+1) points
+      uint j = ((r & (half - 1)) << s) + ((first_set + (e >> rl)) & ((1 << s) - 1));
+      real2 omega = exp_complex((real2)(0.0, dir * - M_PI_R * j / (1 << (s + t))));
+      real2 t8 = mul_complex(omega, x[e + half]);
+      x[e + half] = x[e] - t8;
+      x[e] = x[e] + t8;
+    }
+  }
+}
+
+__kernel void FFT2_R8(__global real2 * a, __local real2 * l, __global const uint * points_per_group, __global real2 * debug, __global const int * dir)
+{
+  uint ppg = *points_per_group;
+  uint lgppg = (uint)log2((float)ppg);
+  uint base = get_group_id(0) * ppg;
+  real2 x[8];
+
+  load_group(a + base, l, ppg, 3);
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for(uint s = 0; s < lgppg; s += 3)
+  {
+    uint rl = min(3u, lgppg - s);
+    uint mask = (1 << rl) - 1;
+    uint first_set = get_local_id(0) * (8 >> rl);
+
+    for(uint e = 0; e < 8; ++e)
+      x[e] = l[R8_PAD(r8_position(first_set + (e >> rl), e & mask, s, rl))];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    r8_pass(x, s, rl, first_set, *dir);
+
+#if TRACE_LEVEL >= 2
+    if(s == 0 && debug != 0)
+    {
+      for(uint e = 0; e < 8; ++e)
+        debug[base + r8_position(first_set + (e >> rl), e & mask, s, rl)] = x[e];
+    }
+#endif
+
+    for(uint e = 0; e < 8; ++e)
+      l[R8_PAD(r8_position(first_set + (e >> rl), e & mask, s, rl))] = x[e];
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  store_group(a + base, l, ppg, 3);
+}
@@ -0,0 +1,203 @@
+#include "PlanCache.h"
+#include "Tuner.h"
+#include "CodeletGen.h"
+#include "oclFFT.h"
+#include "Trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+// 64-bit FNV-1a, continued from h
+static unsigned long long hashBytes(unsigned long long h, const char *p, size_t length)
+{
+  for(size_t i = 0; i < length; i++)
+  {
+    h ^= (unsigned char)p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+string programBinaryName(const string &device_key, cl_uint count, const char **sources,
+                         const size_t *lengths, const char *options)
+{
+  // the terminating zeros keep ("ab", "c") and ("a", "bc") apart
+  unsigned long long h = 14695981039346656037ULL;
+  h = hashBytes(h, device_key.c_str(), device_key.size() + 1);
+  h = hashBytes(h, options ? options : "", (options ? strlen(options) : 0) + 1);
+  for(cl_uint i = 0; i < count; i++)
+    h = hashBytes(h, sources[i], lengths[i]);
+  char name[32];
+  sprintf(name, "fft-%016llx.bin", h);
+  return name;
+}
+
+static bool readBinary(const string &path, vector<unsigned char> &binary)
+{
+  FILE* f = fopen(path.c_str(), "rb");
+  if(f == NULL)
+    return false;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  rewind(f);
+  binary.resize(size > 0 ? size : 0);
+  bool ok = size > 0 && fread(&binary[0], 1, size, f) == (size_t)size;
+  fclose(f);
+  return ok;
+}
+
+static void writeBinary(const string &path, cl_program cpProgram)
+{
+  size_t size = 0;
+  if(clGetProgramInfo(cpProgram, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &size, NULL) != CL_SUCCESS || size == 0)
+    return;
+  vector<unsigned char> binary(size);
+  unsigned char *p = &binary[0];
+  if(clGetProgramInfo(cpProgram, CL_PROGRAM_BINARIES, sizeof(p), &p, NULL) != CL_SUCCESS)
+    return;
+  FILE* f = fopen(path.c_str(), "wb");
+  if(f == NULL)
+  {
+    shrLog("Couldn't write program binary %s\n", path.c_str());
+    return;
+  }
+  fwrite(p, 1, size, f);
+  fclose(f);
+}
+
+cl_program buildProgramCached(cl_context cxContext, cl_device_id cdDevice, cl_uint count, const char **sources,
+                              const size_t *lengths, const char *options, const char *cache_dir,
+                              string &binary_name, int argc, const char **argv)
+{
+  cl_int ciErr;
+  cl_program cpProgram;
+  string path;
+  binary_name.clear();
+
+  if(cache_dir != NULL)
+  {
+    binary_name = programBinaryName(deviceKey(cdDevice), count, sources, lengths, options);
+    path = string(cache_dir) + "/" + binary_name;
+    vector<unsigned char> binary;
+    if(readBinary(path, binary))
+    {
+      size_t size = binary.size();
+      const unsigned char *p = &binary[0];
+      cl_int status = CL_SUCCESS;
+      cpProgram = clCreateProgramWithBinary(cxContext, 1, &cdDevice, &size, &p, &status, &ciErr);
+      if(ciErr == CL_SUCCESS && status == CL_SUCCESS)
+      {
+        ciErr = clBuildProgram(cpProgram, 1, &cdDevice, options, NULL, NULL);
+        if(ciErr == CL_SUCCESS)
+        {
+          TRACE_TIMING(("Program loaded from %s\n", path.c_str()));
+          return cpProgram;
+        }
+      }
+      // a binary the driver no longer takes is rebuilt from source and replaced
+      if(cpProgram != NULL)
+        clReleaseProgram(cpProgram);
+    }
+  }
+
+  cpProgram = clCreateProgramWithSource(cxContext, count, sources, lengths, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateProgramWithSource, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  ciErr = clBuildProgram(cpProgram, 1, &cdDevice, options, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    size_t log_size;
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+    char* program_log = (char *)malloc(log_size + 1);
+    program_log[log_size] = '\0';
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, log_size + 1, program_log, NULL);
+    printf("%s\n", program_log);
+    free(program_log);
+    shrLog("Error in clBuildProgram, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  if(cache_dir != NULL)
+    writeBinary(path, cpProgram);
+  return cpProgram;
+}
+
+cl_program buildFFTProgram(cl_context cxContext, cl_device_id cdDevice, const char *source, size_t source_length,
+                           size_t n, const char *options, const char *cache_dir, string &binary_name,
+                           int argc, const char **argv)
+{
+  string codelet;
+  if(codeletPoints(n) > 0)
+    codelet = generateCodelet(codeletPlan(codeletPoints(n)));
+  const char* sources[2] = { source, codelet.c_str() };
+  size_t lengths[2] = { source_length, codelet.size() };
+  return buildProgramCached(cxContext, cdDevice, codelet.empty() ? 1 : 2, sources, lengths, options, cache_dir,
+                            binary_name, argc, argv);
+}
+
+void generatePlans(cl_context cxContext, cl_device_id cdDevice, const char *source, size_t source_length,
+                   const char *options, size_t point_size, const vector<size_t> &sizes, size_t min_points_per_group,
+                   const char *wisdom_path, const char *cache_dir, bool tune, int argc, const char **argv)
+{
+  string device_key = deviceKey(cdDevice);
+  for(size_t i = 0; i < sizes.size(); i++)
+  {
+    size_t n = sizes[i];
+    if(n < 2 || (n & (n - 1)) != 0)
+    {
+      shrLog("Skipping plan for %u points: not a power of 2\n", (unsigned int)n);
+      continue;
+    }
+
+    string binary_name;
+    cl_program cpProgram = buildFFTProgram(cxContext, cdDevice, source, source_length, n, options, cache_dir,
+                                           binary_name, argc, argv);
+    LaunchConfig config;
+    size_t min_ppg = min_points_per_group > 0 ? min_points_per_group : n;
+    if(tune)
+      config = tuneLaunchConfig(cxContext, cdDevice, cpProgram, "FFT2", n, min_ppg, point_size, argc, argv);
+    else if(codeletPoints(n) == n)
+      config = codeletLaunchConfig(n);
+    else
+    {
+      cl_int ciErr;
+      size_t items_per_group;
+      cl_ulong local_memory_size;
+      cl_kernel ckKernel = clCreateKernel(cpProgram, "FFT2", &ciErr);
+      ciErr |= clGetKernelWorkGroupInfo(ckKernel, cdDevice, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), (void *)&items_per_group, NULL);
+      ciErr |= clGetDeviceInfo(cdDevice, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &local_memory_size, NULL);
+      if (ciErr != CL_SUCCESS)
+      {
+        shrLog("Error in clGetKernelWorkGroupInfo, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+        Cleanup(argc, (char **)argv, EXIT_FAILURE);
+      }
+      clReleaseKernel(ckKernel);
+      config = defaultLaunchConfig(n, items_per_group, local_memory_size, 8, point_size);
+    }
+    storeWisdom(wisdom_path, device_key, n, point_size, config, binary_name);
+    clReleaseProgram(cpProgram);
+    shrLog("Planned %u points: points per group %u, radix %u, binary %s\n", (unsigned int)n,
+           config.points_per_group, config.radix, binary_name.empty() ? "-" : binary_name.c_str());
+  }
+}
+
+vector<size_t> parseSizes(const char *list)
+{
+  vector<size_t> sizes;
+  const char *p = list;
+  while(*p)
+  {
+    char *end;
+    unsigned long n = strtoul(p, &end, 10);
+    if(end == p)
+      break;
+    sizes.push_back(n);
+    p = (*end == ',') ? end + 1 : end;
+  }
+  return sizes;
+}
@@ -0,0 +1,40 @@
+#ifndef _PLANCACHE_H_
+#define _PLANCACHE_H_
+
+#include <oclUtils.h>
+#include <string>
+#include <vector>
+
+/* File name of the binary that sources built with options produce for the device
+   behind device_key (deviceKey): a hash of all three, so an edited kernel or a new
+   driver never picks up a stale binary. */
+std::string programBinaryName(const std::string &device_key, cl_uint count, const char **sources,
+                              const size_t *lengths, const char *options);
+
+/* Builds sources for cdDevice. With a cache_dir the program comes from the binary in
+   it when there is one, and a source build leaves its binary there for next time;
+   binary_name is set to that file's name (empty without a cache_dir). */
+cl_program buildProgramCached(cl_context cxContext, cl_device_id cdDevice, cl_uint count, const char **sources,
+                              const size_t *lengths, const char *options, const char *cache_dir,
+                              std::string &binary_name, int argc, const char **argv);
+
+/* FFT2.cl source plus, from CODELET_MIN_POINTS up, the straight-line codelet of
+   codeletPoints(n) points, built through buildProgramCached. */
+cl_program buildFFTProgram(cl_context cxContext, cl_device_id cdDevice, const char *source, size_t source_length,
+                           size_t n, const char *options, const char *cache_dir, std::string &binary_name,
+                           int argc, const char **argv);
+
+/* Ahead-of-time planning: for every size builds the program (leaving its binary in
+   cache_dir) and stores the launch configuration, tuned when tune is set and
+   derived from the device limits otherwise, as wisdom that references the binary.
+   options and point_size are those of one precision (FFTPrecision<T>), the wisdom
+   is stored under it. Groups get at least min_points_per_group points; 0 means the
+   whole transform. */
+void generatePlans(cl_context cxContext, cl_device_id cdDevice, const char *source, size_t source_length,
+                   const char *options, size_t point_size, const std::vector<size_t> &sizes, size_t min_points_per_group,
+                   const char *wisdom_path, const char *cache_dir, bool tune, int argc, const char **argv);
+
+/* Comma separated list of sizes, as given to --plan-sizes. */
+std::vector<size_t> parseSizes(const char *list);
+
+#endif
@@ -0,0 +1,345 @@
+#include "Scheduler.h"
+#include "oclFFT.h"
+#include "Trace.h"
+#include <sys/time.h>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+#define PROBE_GROUPS 64
+
+static double wallclock(void)
+{
+  struct timeval tim;
+  gettimeofday(&tim, NULL);
+  return (double)tim.tv_sec*1000000 + (double)tim.tv_usec;
+}
+
+cl_int defaultDevice(cl_platform_id *platform, cl_device_id *device)
+{
+  cl_uint num_platforms = 0;
+  cl_int ciErr = clGetPlatformIDs(0, NULL, &num_platforms);
+  if (ciErr != CL_SUCCESS)
+    return ciErr;
+  if (num_platforms == 0)
+    return CL_DEVICE_NOT_FOUND;
+  vector<cl_platform_id> platforms(num_platforms);
+  clGetPlatformIDs(num_platforms, &platforms[0], NULL);
+
+  const cl_device_type types[] = { CL_DEVICE_TYPE_GPU, CL_DEVICE_TYPE_ALL };
+  for(int t = 0; t < 2; t++)
+    for(cl_uint p = 0; p < num_platforms; p++)
+      if(clGetDeviceIDs(platforms[p], types[t], 1, device, NULL) == CL_SUCCESS)
+      {
+        *platform = platforms[p];
+        return CL_SUCCESS;
+      }
+  return CL_DEVICE_NOT_FOUND;
+}
+
+Scheduler::Scheduler(const char *source_file, const char *options, size_t point_size, int argc, const char **argv)
+    : point_size(point_size), planned_n(0), points_per_group(0)
+{
+  cl_int ciErr;
+  cl_uint num_platforms = 0;
+  size_t szKernelLength;
+
+  char* cPathAndName = shrFindFilePath(source_file, argv[0]);
+  if(cPathAndName == NULL)
+    cPathAndName = shrFindFilePath((string("../common/") + source_file).c_str(), argv[0]);
+  char* cSourceCL = oclLoadProgSource(cPathAndName, "", &szKernelLength);
+  if (cSourceCL == NULL)
+  {
+    shrLog("Error in oclLoadProgSource, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ciErr = clGetPlatformIDs(0, NULL, &num_platforms);
+  if (ciErr != CL_SUCCESS || num_platforms == 0)
+  {
+    shrLog("Error in clGetPlatformIDs, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  vector<cl_platform_id> platforms(num_platforms);
+  clGetPlatformIDs(num_platforms, &platforms[0], NULL);
+
+  for(cl_uint p = 0; p < num_platforms; p++)
+  {
+    cl_uint num_devices = 0;
+    if(clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, 0, NULL, &num_devices) != CL_SUCCESS || num_devices == 0)
+      continue;
+    vector<cl_device_id> ids(num_devices);
+    clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, num_devices, &ids[0], NULL);
+
+    for(cl_uint d = 0; d < num_devices; d++)
+    {
+      // a device that can't build or run FFT2 is left out rather than failing the run;
+      // FFT2 gives the work-group limit, plan() swaps in the kernel of the planned radix
+      DeviceSlot slot;
+      char name[256] = "";
+      clGetDeviceInfo(ids[d], CL_DEVICE_NAME, sizeof(name), name, NULL);
+      slot.name = name;
+      slot.cdDevice = ids[d];
+      slot.cqCommandQueue = NULL;
+      slot.cpProgram = NULL;
+      slot.ckKernel = NULL;
+      slot.throughput = 1.0;
+      slot.first_group = 0;
+      slot.num_groups = 0;
+
+      slot.cxContext = clCreateContext(0, 1, &slot.cdDevice, NULL, NULL, &ciErr);
+      if (ciErr != CL_SUCCESS)
+      {
+        shrLog("Skipping device %s: clCreateContext failed\n", name);
+        continue;
+      }
+      slot.cqCommandQueue = clCreateCommandQueue(slot.cxContext, slot.cdDevice, 0, &ciErr);
+      if (ciErr == CL_SUCCESS)
+        slot.cpProgram = clCreateProgramWithSource(slot.cxContext, 1, (const char **)&cSourceCL, &szKernelLength, &ciErr);
+      if (ciErr == CL_SUCCESS)
+        ciErr = clBuildProgram(slot.cpProgram, 0, NULL, options, NULL, NULL);
+      if (ciErr == CL_SUCCESS)
+        slot.ckKernel = clCreateKernel(slot.cpProgram, "FFT2", &ciErr);
+      if (ciErr == CL_SUCCESS)
+        ciErr = clGetKernelWorkGroupInfo(slot.ckKernel, slot.cdDevice, CL_KERNEL_WORK_GROUP_SIZE,
+                                         sizeof(size_t), &slot.items_per_group, NULL);
+      if (ciErr == CL_SUCCESS)
+        ciErr = clGetDeviceInfo(slot.cdDevice, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &slot.local_memory_size, NULL);
+      if (ciErr != CL_SUCCESS)
+      {
+        shrLog("Skipping device %s: %s\n", name, oclErrorString(ciErr));
+        release(slot);
+        continue;
+      }
+
+      TRACE_TIMING(("Scheduler: device %u is %s\n", (unsigned int)devices.size(), name));
+      devices.push_back(slot);
+    }
+  }
+
+  free(cPathAndName);
+  free(cSourceCL);
+
+  if(devices.empty())
+  {
+    shrLog("Error: no OpenCL device could build %s\n", source_file);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
+
+Scheduler::~Scheduler()
+{
+  for(size_t i = 0; i < devices.size(); i++)
+    release(devices[i]);
+}
+
+void Scheduler::release(DeviceSlot &slot)
+{
+  if(slot.ckKernel)clReleaseKernel(slot.ckKernel);
+  if(slot.cpProgram)clReleaseProgram(slot.cpProgram);
+  if(slot.cqCommandQueue)clReleaseCommandQueue(slot.cqCommandQueue);
+  if(slot.cxContext)clReleaseContext(slot.cxContext);
+  slot.ckKernel = NULL;
+  slot.cpProgram = NULL;
+  slot.cqCommandQueue = NULL;
+  slot.cxContext = NULL;
+}
+
+LaunchConfig Scheduler::limitsConfig(const DeviceSlot &slot, size_t n) const
+{
+  return defaultLaunchConfig(n, slot.items_per_group, slot.local_memory_size, 8, point_size);
+}
+
+void Scheduler::plan(size_t n, int argc, const char **argv)
+{
+  cl_int ciErr;
+  char* cWisdomPath = (char *)cWisdomFile;
+  shrGetCmdLineArgumentstr(argc, argv, "wisdom", &cWisdomPath);
+
+  // codelets aren't in the program built here, their wisdom doesn't apply
+  for(size_t i = 0; i < devices.size(); i++)
+  {
+    DeviceSlot &slot = devices[i];
+    if(!loadWisdom(cWisdomPath, deviceKey(slot.cdDevice), n, point_size, slot.config) || slot.config.radix > 8)
+      slot.config = limitsConfig(slot, n);
+  }
+
+  // settle on the smallest points per group; a device that can't hold it at its
+  // limits lowers it again
+  size_t ppg = n;
+  bool agreed = false;
+  while(!agreed)
+  {
+    for(size_t i = 0; i < devices.size(); i++)
+      ppg = min(ppg, (size_t)devices[i].config.points_per_group);
+    agreed = true;
+    for(size_t i = 0; i < devices.size(); i++)
+    {
+      if(devices[i].config.points_per_group == ppg)
+        continue;
+      devices[i].config = limitsConfig(devices[i], ppg);
+      agreed = agreed && devices[i].config.points_per_group == ppg;
+    }
+  }
+
+  for(size_t i = 0; i < devices.size(); i++)
+  {
+    DeviceSlot &slot = devices[i];
+    if(slot.ckKernel)clReleaseKernel(slot.ckKernel);
+    slot.ckKernel = clCreateKernel(slot.cpProgram, groupKernelName(slot.config.radix).c_str(), &ciErr);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clCreateKernel on %s, Line %u in file %s !!!\n\n", slot.name.c_str(), __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    TRACE_TIMING(("Scheduler: %s runs %s, %u points per item, local %u\n", slot.name.c_str(),
+                  groupKernelName(slot.config.radix).c_str(), slot.config.points_per_item,
+                  (unsigned int)slot.config.szLocalWorkSize));
+  }
+  planned_n = n;
+  points_per_group = (unsigned int)ppg;
+}
+
+void Scheduler::partition(size_t num_groups)
+{
+  double total = 0.0;
+  for(size_t i = 0; i < devices.size(); i++)
+    total += devices[i].throughput;
+
+  size_t assigned = 0, fastest = 0;
+  for(size_t i = 0; i < devices.size(); i++)
+  {
+    devices[i].num_groups = (size_t)(num_groups * devices[i].throughput / total);
+    assigned += devices[i].num_groups;
+    if(devices[i].throughput > devices[fastest].throughput)
+      fastest = i;
+  }
+  devices[fastest].num_groups += num_groups - assigned;
+
+  size_t first = 0;
+  for(size_t i = 0; i < devices.size(); i++)
+  {
+    devices[i].first_group = first;
+    first += devices[i].num_groups;
+  }
+}
+
+void Scheduler::runSlices(char *buf, int dir, int argc, const char **argv)
+{
+  cl_int ciErr;
+  vector<cl_mem> buffers;
+
+  // enqueue every slice before waiting on any so the devices run concurrently
+  for(size_t i = 0; i < devices.size(); i++)
+  {
+    DeviceSlot &slot = devices[i];
+    if(slot.num_groups == 0)
+      continue;
+
+    size_t slice_points = slot.num_groups * points_per_group;
+    size_t offset = slot.first_group * points_per_group;
+    size_t szLocal = slot.config.szLocalWorkSize;
+    size_t szGlobal = slice_points / slot.config.points_per_item;
+
+    cl_mem cmData = clCreateBuffer(slot.cxContext, CL_MEM_READ_WRITE, point_size * slice_points, NULL, &ciErr);
+    cl_mem cmDebug = NULL;
+#if FFT_TRACE_LEVEL >= FFT_TRACE_DEBUG
+    cmDebug = clCreateBuffer(slot.cxContext, CL_MEM_READ_WRITE, point_size * slice_points, NULL, &ciErr);
+#endif
+    cl_mem cmPointsPerGroup = clCreateBuffer(slot.cxContext, CL_MEM_READ_ONLY, sizeof(cl_uint), NULL, &ciErr);
+    cl_mem cmDir = clCreateBuffer(slot.cxContext, CL_MEM_READ_ONLY, sizeof(cl_int), NULL, &ciErr);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clCreateBuffer on %s, Line %u in file %s !!!\n\n", slot.name.c_str(), __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    buffers.push_back(cmData);
+    if(cmDebug)
+      buffers.push_back(cmDebug);
+    buffers.push_back(cmPointsPerGroup);
+    buffers.push_back(cmDir);
+
+    ciErr = clEnqueueWriteBuffer(slot.cqCommandQueue, cmData, CL_FALSE, 0, point_size * slice_points, buf + point_size * offset, 0, NULL, NULL);
+    ciErr |= clEnqueueWriteBuffer(slot.cqCommandQueue, cmPointsPerGroup, CL_FALSE, 0, sizeof(cl_uint), &points_per_group, 0, NULL, NULL);
+    ciErr |= clEnqueueWriteBuffer(slot.cqCommandQueue, cmDir, CL_FALSE, 0, sizeof(cl_int), &dir, 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueWriteBuffer on %s, Line %u in file %s !!!\n\n", slot.name.c_str(), __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    ciErr = clSetKernelArg(slot.ckKernel, 0, sizeof(cl_mem), (void*)&cmData);
+    ciErr |= clSetKernelArg(slot.ckKernel, 1, slot.config.local_mem_size, NULL);
+    ciErr |= clSetKernelArg(slot.ckKernel, 2, sizeof(cl_mem), (void*)&cmPointsPerGroup);
+    ciErr |= clSetKernelArg(slot.ckKernel, 3, sizeof(cl_mem), (void*)&cmDebug);
+    ciErr |= clSetKernelArg(slot.ckKernel, 4, sizeof(cl_mem), (void*)&cmDir);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clSetKernelArg on %s, Line %u in file %s !!!\n\n", slot.name.c_str(), __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    ciErr = clEnqueueNDRangeKernel(slot.cqCommandQueue, slot.ckKernel, 1, NULL, &szGlobal, &szLocal, 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueNDRangeKernel on %s, Line %u in file %s !!!\n\n", slot.name.c_str(), __LINE__, __FILE__);
+      shrLog("Error is %s\n", oclErrorString(ciErr));
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    ciErr = clEnqueueReadBuffer(slot.cqCommandQueue, cmData, CL_FALSE, 0, point_size * slice_points, buf + point_size * offset, 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueReadBuffer on %s, Line %u in file %s !!!\n\n", slot.name.c_str(), __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    clFlush(slot.cqCommandQueue);
+  }
+
+  for(size_t i = 0; i < devices.size(); i++)
+    if(devices[i].num_groups > 0)
+      clFinish(devices[i].cqCommandQueue);
+
+  for(size_t i = 0; i < buffers.size(); i++)
+    clReleaseMemObject(buffers[i]);
+}
+
+void Scheduler::measureThroughput(size_t n, int argc, const char **argv)
+{
+  if(planned_n != n)
+    plan(n, argc, argv);
+  unsigned int ppg = points_per_group;
+  size_t probe_groups = n/ppg < PROBE_GROUPS ? n/ppg : PROBE_GROUPS;
+  // zeros time the same as any data and are valid in either precision
+  vector<char> probe(probe_groups * ppg * point_size, 0);
+
+  for(size_t i = 0; i < devices.size(); i++)
+  {
+    for(size_t j = 0; j < devices.size(); j++)
+    {
+      devices[j].first_group = 0;
+      devices[j].num_groups = (i == j) ? probe_groups : 0;
+    }
+    // the first run pays for lazy allocation and kernel upload, time the second
+    runSlices(&probe[0], 1, argc, argv);
+    double start_t = wallclock();
+    runSlices(&probe[0], 1, argc, argv);
+    double us = wallclock() - start_t;
+    devices[i].throughput = probe_groups * ppg / (us > 1.0 ? us : 1.0);
+    TRACE_TIMING(("Scheduler: %s runs %5.2f points/us\n", devices[i].name.c_str(), devices[i].throughput));
+  }
+}
+
+void Scheduler::transformGroups(void *buf, size_t n, int dir, int argc, const char **argv)
+{
+  if(planned_n != n)
+    plan(n, argc, argv);
+  partition(n / points_per_group);
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+  for(size_t i = 0; i < devices.size(); i++)
+    shrLog("Scheduler: %s takes groups %u..%u\n", devices[i].name.c_str(), (unsigned int)devices[i].first_group,
+           (unsigned int)(devices[i].first_group + devices[i].num_groups));
+#endif
+  runSlices((char *)buf, dir, argc, argv);
+}
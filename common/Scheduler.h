@@ -0,0 +1,71 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <oclUtils.h>
+#include "Tuner.h"
+#include <string>
+#include <vector>
+
+/* One OpenCL device with its own context, queue and in-group kernel. */
+struct DeviceSlot
+{
+    std::string name;
+    cl_device_id cdDevice;
+    cl_context cxContext;
+    cl_command_queue cqCommandQueue;
+    cl_program cpProgram;
+    cl_kernel ckKernel;     /* groupKernelName(config.radix) */
+    size_t items_per_group;
+    cl_ulong local_memory_size;
+    LaunchConfig config;    /* for the planned size, at the points per group all devices share */
+    double throughput;      /* measured points per microsecond, transfers included */
+    size_t first_group;     /* share of the current job, in groups */
+    size_t num_groups;
+};
+
+/* The device a single-device run uses: the first GPU on any platform, or the first
+   device of any type (a CPU runtime such as PoCL) when no platform has a GPU.
+   CL_DEVICE_NOT_FOUND when the host has no OpenCL device at all. */
+cl_int defaultDevice(cl_platform_id *platform, cl_device_id *device);
+
+/* Splits the in-group FFT2 work of one transform across every OpenCL device
+   on the host (GPUs and CPU runtimes alike) in proportion to their measured
+   throughput. Each device runs on its own slice of the bit reversed buffer and
+   the results land back in place, ready for the cross-group stages. */
+class Scheduler
+{
+    public:
+        /* Lists all platforms and devices and builds source_file on each with options.
+           point_size is the size of one complex point of that build (FFTPrecision<T>::Complex2);
+           devices that can't build it, such as ones without fp64 for double, are left out. */
+        Scheduler(const char *source_file, const char *options, size_t point_size, int argc, const char **argv);
+        ~Scheduler();
+
+        /* Picks each device's launch configuration for n points, its wisdom when the file has
+           some and the one derived from its limits otherwise, and the in-group kernel of that
+           radix. Every slice has to stop after the same stages for the host to merge them, so
+           devices planned for more points per group fall back to the smallest of them. */
+        void plan(size_t n, int argc, const char **argv);
+        /* Points per group of the last plan. */
+        unsigned int pointsPerGroup() const { return points_per_group; }
+        /* Times a probe transform on each device to weight the split. */
+        void measureThroughput(size_t n, int argc, const char **argv);
+        /* Runs the in-group stages over all n/pointsPerGroup() groups of buf (point_size bytes
+           per point) in place, planning for n first if the last plan was for another size. */
+        void transformGroups(void *buf, size_t n, int dir, int argc, const char **argv);
+        size_t numDevices() const { return devices.size(); }
+        size_t pointSize() const { return point_size; }
+
+    private:
+        std::vector<DeviceSlot> devices;
+        size_t point_size;
+        size_t planned_n;
+        unsigned int points_per_group;
+
+        void partition(size_t num_groups);
+        LaunchConfig limitsConfig(const DeviceSlot &slot, size_t n) const;
+        void runSlices(char *buf, int dir, int argc, const char **argv);
+        void release(DeviceSlot &slot);
+};
+
+#endif
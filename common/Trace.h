@@ -0,0 +1,37 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/* Trace levels of the FFT code, fixed at compile time with -DFFT_TRACE_LEVEL=n.
+   The same level goes to the kernels as -DTRACE_LEVEL=n through FFT_TRACE_OPTIONS.
+
+   0 production: no trace code, no debug buffers, no log output
+   1 timing:     one timing line per transform
+   2 debug:      the kernels also copy their first-stage results to a debug buffer
+                 that the host uploads and reads back on every transform
+   3 stages:     the host transform dumps the whole array after every stage */
+
+#define FFT_TRACE_OFF     0
+#define FFT_TRACE_TIMING  1
+#define FFT_TRACE_DEBUG   2
+#define FFT_TRACE_STAGES  3
+
+#ifndef FFT_TRACE_LEVEL
+  #define FFT_TRACE_LEVEL FFT_TRACE_OFF
+#endif
+
+#define FFT_TRACE_STR2(x) #x
+#define FFT_TRACE_STR(x) FFT_TRACE_STR2(x)
+
+/* Kernel build option carrying the host trace level. */
+#define FFT_TRACE_OPTIONS "-DTRACE_LEVEL=" FFT_TRACE_STR(FFT_TRACE_LEVEL)
+
+/* TRACE_TIMING(("fmt", args)) logs through shrLog from the timing level up and
+   vanishes below it, arguments included. Larger trace blocks sit in
+   #if FFT_TRACE_LEVEL >= ... sections. */
+#if FFT_TRACE_LEVEL >= FFT_TRACE_TIMING
+  #define TRACE_TIMING(args) shrLog args
+#else
+  #define TRACE_TIMING(args)
+#endif
+
+#endif
@@ -0,0 +1,420 @@
+#include "Tuner.h"
+#include "CodeletGen.h"
+#include "oclFFT.h"
+#include "Trace.h"
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+#define TUNER_REPEATS 3
+#define TUNER_TOLERANCE 0.001
+
+string groupKernelName(unsigned int radix)
+{
+  // a radix above 8 is a codelet over the whole group (CodeletGen); the name is
+  // built per call, DevicePlan asks for it from several threads at once
+  if(radix > 8)
+  {
+    char codelet[32];
+    sprintf(codelet, "FFT2_CODELET_%u", radix);
+    return codelet;
+  }
+  return (radix == 8) ? "FFT2_R8" : "FFT2";
+}
+
+size_t groupScratchPoints(size_t ppg, unsigned int radix)
+{
+  // FFT2_R8 pads one point every 8 (R8_PAD in FFT2.cl)
+  if(radix > 8)
+    return 1;
+  return (radix == 8) ? ppg + (ppg >> 3) : ppg;
+}
+
+LaunchConfig defaultLaunchConfig(size_t n, size_t items_per_group, cl_ulong local_memory_size, unsigned int max_radix,
+                                 size_t point_size)
+{
+  LaunchConfig config;
+
+  // half of the local memory holds the group's points, rounded down to a power of 2
+  size_t ppg = 1;
+  while(groupScratchPoints(ppg << 1, max_radix) * point_size <= local_memory_size/2)
+    ppg <<= 1;
+  if(ppg > n)
+    ppg = n;
+
+  // radix 8 whenever a group has 8 points: ppg/8 items, each with 8 points in registers
+  if(max_radix >= 8)
+  {
+    while(ppg > 8 && ppg/8 > items_per_group)
+      ppg >>= 1;
+  }
+  if(max_radix >= 8 && ppg >= 8)
+  {
+    config.points_per_group = ppg;
+    config.points_per_item = 8;
+    config.radix = 8;
+    config.szLocalWorkSize = ppg/8;
+    config.szGlobalWorkSize = n/8;
+    config.local_mem_size = point_size * groupScratchPoints(ppg, 8);
+    config.microseconds = 0.0;
+    return config;
+  }
+
+  size_t ppi = ppg / (items_per_group/2 > 0 ? items_per_group/2 : 1);
+  if(ppi < 4)
+    ppi = 4;
+  if(ppi > ppg)
+    ppi = ppg;
+
+  config.points_per_group = ppg;
+  config.points_per_item = ppi;
+  config.radix = 2;
+  config.szLocalWorkSize = ppg/ppi;
+  config.szGlobalWorkSize = n/ppi;
+  config.local_mem_size = point_size * ppg;
+  config.microseconds = 0.0;
+  return config;
+}
+
+// Expected output of FFT2: every group of ppg points (already in bit reversed
+// order) run through the first log2(ppg) decimation-in-time stages. Point is the
+// program's cl_float2 or cl_double2.
+template <typename Point>
+static void referenceGroups(const vector<Point> &input, vector<double> &ref, size_t n, size_t ppg)
+{
+  ref.resize(2*n);
+  for(size_t i = 0; i < n; i++)
+  {
+    ref[2*i] = input[i].s0;
+    ref[2*i+1] = input[i].s1;
+  }
+  for(size_t m = 2; m <= ppg; m <<= 1)
+  {
+    for(size_t k = 0; k < n; k += m)
+    {
+      for(size_t j = 0; j < (m >> 1); j++)
+      {
+        double angle = -2.0 * M_PI * j / m;
+        double wr = cos(angle), wi = sin(angle);
+        size_t a = 2*(k + j), b = 2*(k + j + (m >> 1));
+        double tr = wr * ref[b] - wi * ref[b+1];
+        double ti = wr * ref[b+1] + wi * ref[b];
+        ref[b] = ref[a] - tr;
+        ref[b+1] = ref[a+1] - ti;
+        ref[a] += tr;
+        ref[a+1] += ti;
+      }
+    }
+  }
+}
+
+template <typename Point>
+static bool matchesReference(const vector<Point> &output, const vector<double> &ref, size_t n)
+{
+  double max_ref = 0.0, max_err = 0.0;
+  for(size_t i = 0; i < n; i++)
+  {
+    max_ref = max(max_ref, max(fabs(ref[2*i]), fabs(ref[2*i+1])));
+    max_err = max(max_err, max(fabs(ref[2*i] - output[i].s0), fabs(ref[2*i+1] - output[i].s1)));
+  }
+  return max_err <= TUNER_TOLERANCE * (max_ref > 1.0 ? max_ref : 1.0);
+}
+
+// Kernel time of one candidate in microseconds (best of TUNER_REPEATS), or -1 if it
+// fails to launch or doesn't reproduce ref.
+template <typename Point>
+static double timeCandidate(cl_command_queue cqTune, cl_kernel ckTune, cl_mem cmData, cl_mem cmPointsPerGroup,
+                            cl_mem cmDebug, cl_mem cmDir, size_t szGlobal, size_t szLocal, size_t local_mem_size,
+                            const vector<Point> &input, vector<Point> &output, const vector<double> &ref, size_t n)
+{
+  cl_int ciErr = clSetKernelArg(ckTune, 0, sizeof(cl_mem), (void*)&cmData);
+  ciErr |= clSetKernelArg(ckTune, 1, local_mem_size, NULL);
+  ciErr |= clSetKernelArg(ckTune, 2, sizeof(cl_mem), (void*)&cmPointsPerGroup);
+  ciErr |= clSetKernelArg(ckTune, 3, sizeof(cl_mem), (void*)&cmDebug);
+  ciErr |= clSetKernelArg(ckTune, 4, sizeof(cl_mem), (void*)&cmDir);
+  if (ciErr != CL_SUCCESS)
+    return -1.0;
+
+  double us = -1.0;
+  for(int r = 0; r < TUNER_REPEATS; r++)
+  {
+    cl_event evKernel;
+    cl_ulong start_time, end_time;
+    clEnqueueWriteBuffer(cqTune, cmData, CL_FALSE, 0, sizeof(Point) * n, &input[0], 0, NULL, NULL);
+    ciErr = clEnqueueNDRangeKernel(cqTune, ckTune, 1, NULL, &szGlobal, &szLocal, 0, NULL, &evKernel);
+    if (ciErr != CL_SUCCESS)
+      return -1.0;
+    clWaitForEvents(1, &evKernel);
+    clGetEventProfilingInfo(evKernel, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start_time, NULL);
+    clGetEventProfilingInfo(evKernel, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end_time, NULL);
+    clReleaseEvent(evKernel);
+    double t = (double)(end_time - start_time) / 1e3;
+    if(us < 0.0 || t < us)
+      us = t;
+
+    if(r == 0)
+    {
+      clEnqueueReadBuffer(cqTune, cmData, CL_TRUE, 0, sizeof(Point) * n, &output[0], 0, NULL, NULL);
+      if(!matchesReference(output, ref, n))
+        return -1.0;
+    }
+  }
+  return us;
+}
+
+template <typename Point>
+static LaunchConfig tuneGroups(cl_context cxContext, cl_device_id cdDevice, cl_program cpProgram,
+                               const char *kernel_name, size_t n, size_t min_points_per_group,
+                               int argc, const char **argv)
+{
+  cl_int ciErr;
+  size_t items_per_group;
+  size_t r8_items = 0;
+  cl_ulong local_memory_size;
+
+  cl_kernel ckTune = clCreateKernel(cpProgram, kernel_name, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  ciErr = clGetKernelWorkGroupInfo(ckTune, cdDevice, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &items_per_group, NULL);
+  ciErr |= clGetDeviceInfo(cdDevice, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &local_memory_size, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clGetDeviceInfo, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // the register-blocked kernel competes too when the program has it
+  cl_kernel ckTuneR8 = clCreateKernel(cpProgram, groupKernelName(8).c_str(), &ciErr);
+  if (ciErr != CL_SUCCESS)
+    ckTuneR8 = NULL;
+  else if (clGetKernelWorkGroupInfo(ckTuneR8, cdDevice, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &r8_items, NULL) != CL_SUCCESS)
+    r8_items = 0;
+  // and so does the codelet, as the in-group kernel of its size
+  unsigned int codelet_ppg = codeletPoints(n);
+  cl_kernel ckCodelet = NULL;
+  if(codelet_ppg > 0)
+  {
+    ckCodelet = clCreateKernel(cpProgram, groupKernelName(codelet_ppg).c_str(), &ciErr);
+    if (ciErr != CL_SUCCESS)
+      ckCodelet = NULL;
+  }
+
+  LaunchConfig best = ckTuneR8 ? defaultLaunchConfig(n, min(items_per_group, r8_items), local_memory_size, 8, sizeof(Point))
+                               : defaultLaunchConfig(n, items_per_group, local_memory_size, 2, sizeof(Point));
+
+  // profiling queue and scratch buffers private to the tuner
+  cl_command_queue cqTune = clCreateCommandQueue(cxContext, cdDevice, CL_QUEUE_PROFILING_ENABLE, &ciErr);
+  cl_mem cmData = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(Point) * n, NULL, &ciErr);
+  cl_mem cmDebug = NULL;
+#if FFT_TRACE_LEVEL >= FFT_TRACE_DEBUG
+  cmDebug = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(Point) * n, NULL, &ciErr);
+#endif
+  cl_mem cmPointsPerGroup = clCreateBuffer(cxContext, CL_MEM_READ_ONLY, sizeof(cl_uint), NULL, &ciErr);
+  cl_mem cmDir = clCreateBuffer(cxContext, CL_MEM_READ_ONLY, sizeof(cl_int), NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  vector<Point> input(n), output(n);
+  srand(2718);
+  for(size_t i = 0; i < n; i++)
+  {
+    input[i].s0 = 2.0f * rand() / RAND_MAX - 1.0f;
+    input[i].s1 = 2.0f * rand() / RAND_MAX - 1.0f;
+  }
+  cl_int dir = 1;
+  clEnqueueWriteBuffer(cqTune, cmDir, CL_TRUE, 0, sizeof(cl_int), &dir, 0, NULL, NULL);
+
+  vector<double> ref;
+  double best_us = -1.0;
+
+  for(size_t ppg = 4; ppg <= n && sizeof(Point) * ppg <= local_memory_size; ppg <<= 1)
+  {
+    if(ppg < min_points_per_group)
+      continue;
+    cl_uint ppg_u = (cl_uint)ppg;
+    clEnqueueWriteBuffer(cqTune, cmPointsPerGroup, CL_TRUE, 0, sizeof(cl_uint), &ppg_u, 0, NULL, NULL);
+    referenceGroups(input, ref, n, ppg);
+
+    // (radix, points per item): radix 2 with every split of the group over its items,
+    // radix 8 with 8 points per item, the codelet with the whole group in one item
+    vector<pair<unsigned int, size_t> > candidates;
+    for(size_t ppi = 4; ppi <= ppg; ppi <<= 1)
+      candidates.push_back(make_pair(2u, ppi));
+    if(ckTuneR8 != NULL && ppg >= 8)
+      candidates.push_back(make_pair(8u, (size_t)8));
+    if(ckCodelet != NULL && ppg == codelet_ppg)
+      candidates.push_back(make_pair((unsigned int)ppg, ppg));
+
+    for(size_t c = 0; c < candidates.size(); c++)
+    {
+      unsigned int radix = candidates[c].first;
+      size_t points = candidates[c].second;
+      size_t szLocal = ppg/points;
+      size_t szGlobal = n/points;
+      size_t local_mem_size = sizeof(Point) * groupScratchPoints(ppg, radix);
+      if(szLocal > ((radix == 8) ? r8_items : items_per_group) || local_mem_size > local_memory_size)
+        continue;
+
+      cl_kernel ckCandidate = (radix > 8) ? ckCodelet : (radix == 8) ? ckTuneR8 : ckTune;
+      double us = timeCandidate(cqTune, ckCandidate, cmData, cmPointsPerGroup, cmDebug, cmDir,
+                                szGlobal, szLocal, local_mem_size, input, output, ref, n);
+      TRACE_TIMING(("Tuner: n %u ppg %u ppi %u radix %u local %u -> %s %5.2f us\n", (unsigned int)n, (unsigned int)ppg,
+                    (unsigned int)points, radix, (unsigned int)szLocal, us >= 0.0 ? "ok" : "rejected", us));
+      if(us < 0.0)
+        continue;
+
+      if(best_us < 0.0 || us < best_us)
+      {
+        best_us = us;
+        best.points_per_group = ppg;
+        best.points_per_item = points;
+        best.radix = radix;
+        best.szLocalWorkSize = szLocal;
+        best.szGlobalWorkSize = szGlobal;
+        best.local_mem_size = local_mem_size;
+        best.microseconds = us;
+      }
+    }
+  }
+
+  if(best_us < 0.0)
+    shrLog("Tuner: no candidate validated, keeping the default configuration\n");
+
+  clReleaseMemObject(cmData);
+  if(cmDebug)clReleaseMemObject(cmDebug);
+  clReleaseMemObject(cmPointsPerGroup);
+  clReleaseMemObject(cmDir);
+  clReleaseCommandQueue(cqTune);
+  if(ckCodelet)clReleaseKernel(ckCodelet);
+  if(ckTuneR8)clReleaseKernel(ckTuneR8);
+  clReleaseKernel(ckTune);
+  return best;
+}
+
+LaunchConfig tuneLaunchConfig(cl_context cxContext, cl_device_id cdDevice, cl_program cpProgram,
+                              const char *kernel_name, size_t n, size_t min_points_per_group,
+                              size_t point_size, int argc, const char **argv)
+{
+  if(point_size == sizeof(cl_double2))
+    return tuneGroups<cl_double2>(cxContext, cdDevice, cpProgram, kernel_name, n, min_points_per_group, argc, argv);
+  return tuneGroups<cl_float2>(cxContext, cdDevice, cpProgram, kernel_name, n, min_points_per_group, argc, argv);
+}
+
+string deviceKey(cl_device_id cdDevice)
+{
+  char name[256] = "";
+  char driver[256] = "";
+  clGetDeviceInfo(cdDevice, CL_DEVICE_NAME, sizeof(name), name, NULL);
+  clGetDeviceInfo(cdDevice, CL_DRIVER_VERSION, sizeof(driver), driver, NULL);
+  string key = string(name) + "@" + driver;
+  for(size_t i = 0; i < key.size(); i++)
+    if(key[i] == ' ' || key[i] == '\t')
+      key[i] = '_';
+  return key;
+}
+
+// Device column of the wisdom file: the device key, with ":double" appended for double
+// precision points. Files written before the precision was part of the key only have
+// float entries, which keep reading as such.
+static string wisdomKey(const string &device, size_t point_size)
+{
+  return (point_size == sizeof(cl_double2)) ? device + ":double" : device;
+}
+
+// One line per entry: device n points_per_group points_per_item radix local global local_mem microseconds binary.
+// The binary column is "-" without one and missing altogether in files written before it existed.
+static bool parseWisdomLine(const char *line, char *device, unsigned long &n, LaunchConfig &config, char *binary)
+{
+  unsigned long local, global, lmem;
+  if(line[0] == '#')
+    return false;
+  int fields = sscanf(line, "%255s %lu %u %u %u %lu %lu %lu %lf %255s", device, &n, &config.points_per_group,
+                      &config.points_per_item, &config.radix, &local, &global, &lmem, &config.microseconds, binary);
+  if(fields < 9)
+    return false;
+  if(fields == 9 || strcmp(binary, "-") == 0)
+    binary[0] = '\0';
+  config.szLocalWorkSize = local;
+  config.szGlobalWorkSize = global;
+  config.local_mem_size = lmem;
+  return true;
+}
+
+bool loadWisdom(const char *path, const string &device, size_t n, size_t point_size, LaunchConfig &config, string *binary)
+{
+  string key = wisdomKey(device, point_size);
+  FILE* f = fopen(path, "r");
+  if(f == NULL)
+    return false;
+
+  char line[512];
+  char entry_device[256];
+  char entry_binary[256];
+  unsigned long entry_n;
+  LaunchConfig entry;
+  bool found = false;
+  while(!found && fgets(line, sizeof(line), f) != NULL)
+  {
+    if(parseWisdomLine(line, entry_device, entry_n, entry, entry_binary) && key == entry_device && entry_n == n)
+    {
+      config = entry;
+      if(binary != NULL)
+        *binary = entry_binary;
+      found = true;
+    }
+  }
+  fclose(f);
+  return found;
+}
+
+void storeWisdom(const char *path, const string &device, size_t n, size_t point_size, const LaunchConfig &config,
+                 const string &binary)
+{
+  string key = wisdomKey(device, point_size);
+  vector<string> lines;
+  char line[512];
+  char entry_device[256];
+  char entry_binary[256];
+  unsigned long entry_n;
+  LaunchConfig entry;
+
+  FILE* f = fopen(path, "r");
+  if(f != NULL)
+  {
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+      if(!parseWisdomLine(line, entry_device, entry_n, entry, entry_binary))
+        continue;
+      if(key == entry_device && entry_n == n)
+        continue;
+      lines.push_back(line);
+    }
+    fclose(f);
+  }
+
+  f = fopen(path, "w");
+  if(f == NULL)
+  {
+    shrLog("Couldn't write wisdom file %s\n", path);
+    return;
+  }
+  fprintf(f, "# device n points_per_group points_per_item radix local global local_mem microseconds binary\n");
+  for(size_t i = 0; i < lines.size(); i++)
+    fputs(lines[i].c_str(), f);
+  fprintf(f, "%s %lu %u %u %u %lu %lu %lu %.2f %s\n", key.c_str(), (unsigned long)n, config.points_per_group,
+          config.points_per_item, config.radix, (unsigned long)config.szLocalWorkSize,
+          (unsigned long)config.szGlobalWorkSize, (unsigned long)config.local_mem_size, config.microseconds,
+          binary.empty() ? "-" : binary.c_str());
+  fclose(f);
+}
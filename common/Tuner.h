@@ -0,0 +1,54 @@
+#ifndef _TUNER_H_
+#define _TUNER_H_
+
+#include <oclUtils.h>
+#include <string>
+
+/* One launch configuration of the FFT2 kernel for a given device and size. */
+struct LaunchConfig
+{
+    unsigned int points_per_group;  /* points transformed in local memory per work-group */
+    unsigned int points_per_item;   /* points handled by one work-item */
+    unsigned int radix;             /* butterfly radix of the in-group stages */
+    size_t szLocalWorkSize;
+    size_t szGlobalWorkSize;
+    size_t local_mem_size;          /* bytes of __local scratch (kernel argument 1) */
+    double microseconds;            /* measured kernel time, 0 if never timed */
+};
+
+/* Kernel of FFT2.cl running the in-group stages at radix (FFT2_R8 for 8, FFT2 below it);
+   above 8 it is the generated codelet of that many points (CodeletGen.h). */
+std::string groupKernelName(unsigned int radix);
+/* Points of __local scratch that kernel needs for a group of ppg points (one for a codelet,
+   which works in registers but still takes the argument). */
+size_t groupScratchPoints(size_t ppg, unsigned int radix);
+
+/* Configuration derived from the device limits alone, used when there is no wisdom.
+   Radix 8 (FFT2_R8) is picked whenever max_radix allows it and a group has 8 points.
+   point_size is the size of one complex point of the program (FFTPrecision<T>::Complex2). */
+LaunchConfig defaultLaunchConfig(size_t n, size_t items_per_group, cl_ulong local_memory_size,
+                                 unsigned int max_radix = 8, size_t point_size = sizeof(cl_float2));
+
+/* Times every legal candidate for an n-point transform on cdDevice and returns the fastest.
+   Candidates with fewer than min_points_per_group points per group are skipped. kernel_name
+   is the radix-2 kernel; FFT2_R8 and the codelet of codeletPoints(n) points (CodeletGen.h)
+   are tried as well when cpProgram has them. cpProgram holds
+   points of point_size bytes, sizeof(cl_float2) or sizeof(cl_double2). */
+LaunchConfig tuneLaunchConfig(cl_context cxContext, cl_device_id cdDevice, cl_program cpProgram,
+                              const char *kernel_name, size_t n, size_t min_points_per_group,
+                              size_t point_size, int argc, const char **argv);
+
+/* Key under which wisdom for a device is stored (device name and driver version). */
+std::string deviceKey(cl_device_id cdDevice);
+
+/* Looks up the stored winner for (device, precision, n), the precision given by the point
+   size. Returns false if the file has none. binary, if given, gets the program binary the
+   entry was planned with (empty if none). */
+bool loadWisdom(const char *path, const std::string &device, size_t n, size_t point_size, LaunchConfig &config,
+                std::string *binary = NULL);
+/* Adds or replaces the entry for (device, precision, n) in the wisdom file, with the name
+   of the program binary in the cache (PlanCache.h) if there is one. */
+void storeWisdom(const char *path, const std::string &device, size_t n, size_t point_size, const LaunchConfig &config,
+                 const std::string &binary = std::string());
+
+#endif
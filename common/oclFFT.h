@@ -3,4 +3,7 @@
 
 void Cleanup (int argc, char **argv, int iExitCode);
 
+/* Default wisdom file of the tool (--wisdom overrides it). */
+extern const char* cWisdomFile;
+
 #endif
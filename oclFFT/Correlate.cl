@@ -0,0 +1,56 @@
+// Peak search over batched cross-correlations, one work-group per row of n points
+// (natural order, as the inverse pass of Convolve.cl leaves them). Lags 0..pos_lags-1
+// sit at the start of a row and the negative lags -1..-neg_lags wrap around to its end;
+// everything in between is padding. Only the peak and its two neighbours go back to the
+// host, which fits the parabola through them.
+
+// real part of the correlation at index i of the row, wrapped
+float corr_value(__global const float2 * row, uint n, int i)
+{
+  return row[(uint)(i + (int)n) % n].s0;
+}
+
+__kernel void CORR_PEAK(__global const float2 * rows, const uint n, const uint pos_lags, const uint neg_lags,
+                        __local float * l_value, __local uint * l_index, __global uint * index,
+                        __global float4 * values)
+{
+  uint r = get_group_id(0);
+  uint t = get_local_id(0);
+  uint items = get_local_size(0);
+  __global const float2 * row = rows + r * n;
+
+  float best = -MAXFLOAT;
+  uint best_index = 0;
+  uint lags = pos_lags + neg_lags;
+  for(uint j = t; j < lags; j += items)
+  {
+    uint i = (j < pos_lags) ? j : n - (j - pos_lags) - 1;
+    float v = row[i].s0;
+    if(v > best)
+    {
+      best = v;
+      best_index = i;
+    }
+  }
+  l_value[t] = best;
+  l_index[t] = best_index;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // the group size is a power of 2
+  for(uint s = items >> 1; s > 0; s >>= 1)
+  {
+    if(t < s && l_value[t + s] > l_value[t])
+    {
+      l_value[t] = l_value[t + s];
+      l_index[t] = l_index[t + s];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  if(t == 0)
+  {
+    int i = (int)l_index[0];
+    index[r] = (uint)i;
+    values[r] = (float4)(corr_value(row, n, i - 1), l_value[0], corr_value(row, n, i + 1), 0.0f);
+  }
+}
@@ -0,0 +1,201 @@
+#include "Correlator.h"
+#include "Convolver.h"
+#include "oclFFT.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#define PEAK_GROUP_SIZE 256
+
+using namespace std;
+
+Correlator::Correlator(Convolver& convolver, cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue,
+                       const vector<float>& reference, size_t signal_points, size_t batch, int argc, const char **argv)
+    : convolver(convolver), cqCommandQueue(cqCommandQueue), reference_points(reference.size()),
+      signal_points(signal_points), batch(batch > 0 ? batch : 1)
+{
+  assert(reference_points > 0 && signal_points > 0);
+  // room for every lag without the circular correlation wrapping onto itself
+  n = Convolver::transformSize(signal_points + reference_points - 1);
+
+  cl_int ciErr;
+  size_t szKernelLength;
+  char* cPathAndName = shrFindFilePath("Correlate.cl", argv[0]);
+  cSourceCL = oclLoadProgSource(cPathAndName, "", &szKernelLength);
+  free(cPathAndName);
+
+  cpProgram = clCreateProgramWithSource(cxContext, 1, (const char **)&cSourceCL, &szKernelLength, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateProgramWithSource, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  ciErr = clBuildProgram(cpProgram, 1, &cdDevice, NULL, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    size_t log_size;
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+    char* program_log = (char *)malloc(log_size + 1);
+    program_log[log_size] = '\0';
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, log_size + 1, program_log, NULL);
+    printf("%s\n", program_log);
+    free(program_log);
+    shrLog("Error in clBuildProgram, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ckPeak = clCreateKernel(cpProgram, "CORR_PEAK", &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  size_t max_items;
+  ciErr = clGetKernelWorkGroupInfo(ckPeak, cdDevice, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), (void *)&max_items, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clGetKernelWorkGroupInfo, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  group_size = 1;
+  while(group_size < PEAK_GROUP_SIZE && 2 * group_size <= max_items)
+    group_size <<= 1;
+
+  cmReference = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n, NULL, &ciErr);
+  cmRows = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n * this->batch, NULL, &ciErr);
+  cmPeakIndex = clCreateBuffer(cxContext, CL_MEM_WRITE_ONLY, sizeof(cl_uint) * this->batch, NULL, &ciErr);
+  cmPeakValues = clCreateBuffer(cxContext, CL_MEM_WRITE_ONLY, sizeof(cl_float4) * this->batch, NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // for a real reference the pass with conjugate twiddles is the conjugate of its
+  // spectrum, so the product below is already S * conj(R)
+  staging.resize(n * this->batch);
+  for(size_t i = 0; i < n; i++)
+  {
+    staging[i].x = (i < reference_points) ? reference[i] : 0.0f;
+    staging[i].y = 0.0f;
+  }
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmReference, CL_TRUE, 0, sizeof(cl_float2) * n, &staging[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  convolver.forward(cmReference, n, 1, argc, argv, -1, reference_points);
+
+  cl_uint points = (cl_uint)n;
+  cl_uint pos_lags = (cl_uint)signal_points;
+  cl_uint neg_lags = (cl_uint)(reference_points - 1);
+  ciErr = clSetKernelArg(ckPeak, 0, sizeof(cl_mem), (void*)&cmRows);
+  ciErr |= clSetKernelArg(ckPeak, 1, sizeof(cl_uint), (void*)&points);
+  ciErr |= clSetKernelArg(ckPeak, 2, sizeof(cl_uint), (void*)&pos_lags);
+  ciErr |= clSetKernelArg(ckPeak, 3, sizeof(cl_uint), (void*)&neg_lags);
+  ciErr |= clSetKernelArg(ckPeak, 4, sizeof(cl_float) * group_size, NULL);
+  ciErr |= clSetKernelArg(ckPeak, 5, sizeof(cl_uint) * group_size, NULL);
+  ciErr |= clSetKernelArg(ckPeak, 6, sizeof(cl_mem), (void*)&cmPeakIndex);
+  ciErr |= clSetKernelArg(ckPeak, 7, sizeof(cl_mem), (void*)&cmPeakValues);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
+
+Correlator::~Correlator()
+{
+  if(cmPeakValues)clReleaseMemObject(cmPeakValues);
+  if(cmPeakIndex)clReleaseMemObject(cmPeakIndex);
+  if(cmRows)clReleaseMemObject(cmRows);
+  if(cmReference)clReleaseMemObject(cmReference);
+  if(ckPeak)clReleaseKernel(ckPeak);
+  if(cpProgram)clReleaseProgram(cpProgram);
+  if(cSourceCL)free(cSourceCL);
+}
+
+void Correlator::runRows(const float *signals, size_t rows, int argc, const char **argv)
+{
+  for(size_t r = 0; r < rows; r++)
+  {
+    const float *src = signals + r * signal_points;
+    cl_float2 *row = &staging[r * n];
+    for(size_t i = 0; i < n; i++)
+    {
+      row[i].x = (i < signal_points) ? src[i] : 0.0f;
+      row[i].y = 0.0f;
+    }
+  }
+
+  cl_int ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmRows, CL_FALSE, 0, sizeof(cl_float2) * n * rows, &staging[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  convolver.forward(cmRows, n, rows, argc, argv, 1, signal_points);
+  convolver.multiply(cmRows, cmReference, n * rows, 0, n, 1.0f / n, argc, argv);
+  convolver.inverse(cmRows, n, rows, argc, argv);
+}
+
+void Correlator::correlate(const float *signals, size_t count, vector<CorrelationPeak>& peaks,
+                          int argc, const char **argv)
+{
+  peaks.resize(count);
+  vector<cl_uint> index(batch);
+  vector<cl_float4> values(batch);
+  for(size_t first = 0; first < count; first += batch)
+  {
+    size_t rows = min(batch, count - first);
+    runRows(signals + first * signal_points, rows, argc, argv);
+
+    size_t szGlobalWorkSize = rows * group_size;
+    cl_int ciErr = clEnqueueNDRangeKernel(cqCommandQueue, ckPeak, 1, NULL, &szGlobalWorkSize, &group_size, 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    ciErr = clEnqueueReadBuffer(cqCommandQueue, cmPeakIndex, CL_FALSE, 0, sizeof(cl_uint) * rows, &index[0], 0, NULL, NULL);
+    ciErr |= clEnqueueReadBuffer(cqCommandQueue, cmPeakValues, CL_TRUE, 0, sizeof(cl_float4) * rows, &values[0], 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    for(size_t r = 0; r < rows; r++)
+    {
+      // vertex of the parabola through the peak and its neighbours, within half a sample of it
+      double left = values[r].s[0], peak = values[r].s[1], right = values[r].s[2];
+      double curvature = left - 2.0 * peak + right;
+      double offset = (curvature < 0.0) ? 0.5 * (left - right) / curvature : 0.0;
+      offset = max(-0.5, min(0.5, offset));
+      long lag = (index[r] < signal_points) ? (long)index[r] : (long)index[r] - (long)n;
+      peaks[first + r].lag = lag + offset;
+      peaks[first + r].value = (float)(peak - 0.25 * (left - right) * offset);
+    }
+  }
+}
+
+void Correlator::correlation(const float *signal, vector<float>& out, int argc, const char **argv)
+{
+  runRows(signal, 1, argc, argv);
+  cl_int ciErr = clEnqueueReadBuffer(cqCommandQueue, cmRows, CL_TRUE, 0, sizeof(cl_float2) * n, &staging[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // negative lags wrapped to the end of the row come first
+  size_t neg_lags = reference_points - 1;
+  out.resize(neg_lags + signal_points);
+  for(size_t j = 0; j < neg_lags; j++)
+    out[j] = staging[n - neg_lags + j].x;
+  for(size_t j = 0; j < signal_points; j++)
+    out[neg_lags + j] = staging[j].x;
+}
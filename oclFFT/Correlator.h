@@ -0,0 +1,61 @@
+#ifndef _CORRELATOR_H_
+#define _CORRELATOR_H_
+
+#include <oclUtils.h>
+#include <vector>
+
+class Convolver;
+
+/* Best alignment of one signal with the reference: signal[i + lag] matches
+   reference[i] best. lag is refined to a fraction of a sample by the parabola
+   through the peak and its neighbours; value is the correlation at the peak. */
+struct CorrelationPeak
+{
+    double lag;
+    float value;
+};
+
+/* Cross-correlation of many real signals against one real reference. The
+   reference spectrum is conjugated and kept on the device, every batch of
+   signals is transformed, multiplied by it and transformed back there
+   (Convolver), and the peak of each correlation is found on the device too
+   (Correlate.cl), so only a few values per signal are read back. */
+class Correlator
+{
+    public:
+        /* Signals are signal_points long and go through the device batch at a time. */
+        Correlator(Convolver& convolver, cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue,
+                   const std::vector<float>& reference, size_t signal_points, size_t batch, int argc, const char **argv);
+        ~Correlator();
+
+        /* Peaks of count signals stored back to back, signal_points each, over lags
+           -(reference points - 1) .. signal_points - 1. */
+        void correlate(const float *signals, size_t count, std::vector<CorrelationPeak>& peaks,
+                       int argc, const char **argv);
+        /* The whole correlation of one signal: out[j] is lag j - (reference points - 1). */
+        void correlation(const float *signal, std::vector<float>& out, int argc, const char **argv);
+
+        size_t fftSize() const { return n; }
+
+    private:
+        Convolver& convolver;
+        cl_command_queue cqCommandQueue;
+        cl_program cpProgram;
+        cl_kernel ckPeak;
+        cl_mem cmReference;         /* conjugate reference spectrum, bit reversed, computed once */
+        cl_mem cmRows;              /* batch rows of n points */
+        cl_mem cmPeakIndex;
+        cl_mem cmPeakValues;        /* (left, peak, right, 0) per row */
+        size_t reference_points;
+        size_t signal_points;
+        size_t n;
+        size_t batch;
+        size_t group_size;          /* power of 2 work-group of CORR_PEAK */
+        std::vector<cl_float2> staging;
+        char* cSourceCL;
+
+        /* Correlations of the first rows signals, natural order in cmRows. */
+        void runRows(const float *signals, size_t rows, int argc, const char **argv);
+};
+
+#endif
@@ -0,0 +1,37 @@
+// Tiled transpose for the multidimensional FFT. The rows x cols input holds rows
+// that have just been transformed and are in bit reversed order, so input column c
+// is written to output row reverse(c): the transpose puts the spectrum back in
+// natural order for free. Both the reads and the writes are row contiguous, the
+// local tile (padded by one column against bank conflicts) does the turn.
+
+#ifndef TILE_DIM
+	#define TILE_DIM 16
+#endif
+
+uint reverse_bits(uint x, uint bits)
+{
+  x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+  x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+  x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+  x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+  x = (x >> 16) | (x << 16);
+  return x >> (32 - bits);
+}
+
+__kernel void TRANSPOSE_BITREV(__global float2 * out, __global const float2 * in, const uint rows, const uint cols,
+                               const uint lg_cols, const float scale)
+{
+  __local float2 tile[TILE_DIM][TILE_DIM + 1];
+  uint lx = get_local_id(0);
+  uint ly = get_local_id(1);
+  uint row0 = get_group_id(1) * TILE_DIM;
+  uint col0 = get_group_id(0) * TILE_DIM;
+
+  if(row0 + ly < rows && col0 + lx < cols)
+    tile[ly][lx] = in[(row0 + ly) * cols + col0 + lx];
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // work-item (lx, ly) now writes input column col0 + ly, input row row0 + lx
+  if(col0 + ly < cols && row0 + lx < rows)
+    out[reverse_bits(col0 + ly, lg_cols) * rows + row0 + lx] = tile[lx][ly] * scale;
+}
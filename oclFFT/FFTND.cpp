@@ -0,0 +1,227 @@
+#include "FFTND.h"
+#include "Convolver.h"
+#include "CpuEngine.h"
+#include "oclFFT.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#define HOST_TILE 32
+
+using namespace std;
+
+static unsigned int ilog2(size_t n)
+{
+  unsigned int lg = 0;
+  while(((size_t)1 << lg) < n)
+    lg++;
+  return lg;
+}
+
+size_t FFTND::points(const vector<size_t>& dims)
+{
+  size_t total = 1;
+  for(size_t d = 0; d < dims.size(); d++)
+  {
+    assert(dims[d] >= 2 && (dims[d] & (dims[d] - 1)) == 0);
+    total *= dims[d];
+  }
+  return total;
+}
+
+// ---------------------------------------------------------------------------
+// host
+
+struct RowJob
+{
+    cl_float2 *src;
+    cl_float2 *dst;
+    size_t rows;
+    size_t cols;
+    unsigned int lg_cols;
+    float scale;
+};
+
+// rows are transformed by decimation in time, so they are bit reversed first
+static void bitReverseRows(void *arg, size_t first, size_t last)
+{
+  RowJob *job = (RowJob *)arg;
+  for(size_t r = first; r < last; r++)
+  {
+    cl_float2 *row = job->src + r * job->cols;
+    for(size_t i = 0, j = 0; i < job->cols; i++)
+    {
+      if(i < j)
+        swap(row[i], row[j]);
+      size_t bit = job->cols >> 1;
+      for(; j & bit; bit >>= 1)
+        j ^= bit;
+      j |= bit;
+    }
+  }
+}
+
+// dst (cols x rows) = src (rows x cols) transposed, one band of HOST_TILE source rows per unit
+static void transposeBands(void *arg, size_t first, size_t last)
+{
+  RowJob *job = (RowJob *)arg;
+  for(size_t band = first; band < last; band++)
+  {
+    size_t r0 = band * HOST_TILE;
+    size_t r1 = min(r0 + HOST_TILE, job->rows);
+    for(size_t c0 = 0; c0 < job->cols; c0 += HOST_TILE)
+    {
+      size_t c1 = min(c0 + HOST_TILE, job->cols);
+      for(size_t c = c0; c < c1; c++)
+      {
+        cl_float2 *out = job->dst + c * job->rows;
+        for(size_t r = r0; r < r1; r++)
+        {
+          out[r].x = job->src[r * job->cols + c].x * job->scale;
+          out[r].y = job->src[r * job->cols + c].y * job->scale;
+        }
+      }
+    }
+  }
+}
+
+void FFTND::transform(vector<cl_float2>& data, const vector<size_t>& dims, int dir)
+{
+  size_t total = points(dims);
+  assert(data.size() == total);
+  CpuEngine &engine = CpuEngine::shared();
+  vector<cl_float2> scratch(total);
+
+  for(size_t pass = 0; pass < dims.size(); pass++)
+  {
+    RowJob job;
+    job.cols = dims[dims.size() - 1 - pass];
+    job.rows = total / job.cols;
+    job.lg_cols = ilog2(job.cols);
+    job.src = &data[0];
+    job.dst = &scratch[0];
+    job.scale = (pass + 1 == dims.size() && dir > 0) ? 1.0f / total : 1.0f;
+
+    engine.parallelFor(job.rows, bitReverseRows, &job);
+    engine.stages(&data[0], 0, total, 0, job.lg_cols - 1, dir);
+    engine.parallelFor((job.rows + HOST_TILE - 1) / HOST_TILE, transposeBands, &job);
+    data.swap(scratch);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// device
+
+FFTND::FFTND(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue, Convolver& convolver,
+             int argc, const char **argv)
+    : cxContext(cxContext), cqCommandQueue(cqCommandQueue), convolver(convolver), cmScratch(NULL), scratch_points(0)
+{
+  cl_int ciErr;
+  size_t szKernelLength;
+  char* cPathAndName = shrFindFilePath("FFTND.cl", argv[0]);
+  cSourceCL = oclLoadProgSource(cPathAndName, "", &szKernelLength);
+  free(cPathAndName);
+
+  // 16x16 tiles where a work-group can hold them, 8x8 otherwise
+  size_t max_items;
+  clGetDeviceInfo(cdDevice, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), (void *)&max_items, NULL);
+  tile = (max_items >= 256) ? 16 : 8;
+  char flags[32];
+  sprintf(flags, "-DTILE_DIM=%u", (unsigned int)tile);
+
+  cpProgram = clCreateProgramWithSource(cxContext, 1, (const char **)&cSourceCL, &szKernelLength, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateProgramWithSource, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  ciErr = clBuildProgram(cpProgram, 1, &cdDevice, flags, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    size_t log_size;
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+    char* program_log = (char *)malloc(log_size + 1);
+    program_log[log_size] = '\0';
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, log_size + 1, program_log, NULL);
+    printf("%s\n", program_log);
+    free(program_log);
+    shrLog("Error in clBuildProgram, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ckTranspose = clCreateKernel(cpProgram, "TRANSPOSE_BITREV", &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
+
+FFTND::~FFTND()
+{
+  if(cmScratch)clReleaseMemObject(cmScratch);
+  if(ckTranspose)clReleaseKernel(ckTranspose);
+  if(cpProgram)clReleaseProgram(cpProgram);
+  if(cSourceCL)free(cSourceCL);
+}
+
+void FFTND::transformGPU(cl_mem cmData, const vector<size_t>& dims, int dir, int argc, const char **argv)
+{
+  cl_int ciErr;
+  size_t total = points(dims);
+  if(total > scratch_points)
+  {
+    if(cmScratch)clReleaseMemObject(cmScratch);
+    cmScratch = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * total, NULL, &ciErr);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    scratch_points = total;
+  }
+
+  cl_mem cmSrc = cmData, cmDst = cmScratch;
+  for(size_t pass = 0; pass < dims.size(); pass++)
+  {
+    cl_uint cols = (cl_uint)dims[dims.size() - 1 - pass];
+    cl_uint rows = (cl_uint)(total / cols);
+    cl_uint lg_cols = ilog2(cols);
+    cl_float scale = (pass + 1 == dims.size() && dir > 0) ? 1.0f / total : 1.0f;
+
+    // the rows come out bit reversed, the transpose undoes that
+    convolver.forward(cmSrc, cols, rows, argc, argv, dir);
+
+    ciErr = clSetKernelArg(ckTranspose, 0, sizeof(cl_mem), (void*)&cmDst);
+    ciErr |= clSetKernelArg(ckTranspose, 1, sizeof(cl_mem), (void*)&cmSrc);
+    ciErr |= clSetKernelArg(ckTranspose, 2, sizeof(cl_uint), (void*)&rows);
+    ciErr |= clSetKernelArg(ckTranspose, 3, sizeof(cl_uint), (void*)&cols);
+    ciErr |= clSetKernelArg(ckTranspose, 4, sizeof(cl_uint), (void*)&lg_cols);
+    ciErr |= clSetKernelArg(ckTranspose, 5, sizeof(cl_float), (void*)&scale);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    size_t szLocalWorkSize[2] = { tile, tile };
+    size_t szGlobalWorkSize[2] = { (cols + tile - 1) / tile * tile, (rows + tile - 1) / tile * tile };
+    ciErr = clEnqueueNDRangeKernel(cqCommandQueue, ckTranspose, 2, NULL, szGlobalWorkSize, szLocalWorkSize, 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    swap(cmSrc, cmDst);
+  }
+
+  // an odd number of passes leaves the result in the scratch buffer
+  if(cmSrc != cmData)
+  {
+    ciErr = clEnqueueCopyBuffer(cqCommandQueue, cmSrc, cmData, 0, 0, sizeof(cl_float2) * total, 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueCopyBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef _FFTND_H_
+#define _FFTND_H_
+
+#include <oclUtils.h>
+#include <vector>
+
+class Convolver;
+
+/* Multidimensional FFT of a row major array (last dimension fastest), every
+   dimension a power of 2 of at least 2. Each pass transforms the fastest axis
+   as a batch of contiguous rows and then rotates it to the slowest position
+   with a cache blocked (host) or local memory tiled (device) transpose, so no
+   pass ever walks a strided column. After one pass per axis the array is back
+   in its original layout. Like FFT, the forward transform is scaled by 1/N. */
+class FFTND
+{
+    public:
+        /* Device transforms run their rows through convolver. */
+        FFTND(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue, Convolver& convolver,
+              int argc, const char **argv);
+        ~FFTND();
+
+        /* In place on the device; dir is 1 forward, -1 inverse. */
+        void transformGPU(cl_mem cmData, const std::vector<size_t>& dims, int dir, int argc, const char **argv);
+        /* In place on the host engine threads. */
+        static void transform(std::vector<cl_float2>& data, const std::vector<size_t>& dims, int dir);
+
+        static size_t points(const std::vector<size_t>& dims);
+
+    private:
+        cl_context cxContext;
+        cl_command_queue cqCommandQueue;
+        Convolver& convolver;
+        cl_program cpProgram;
+        cl_kernel ckTranspose;
+        cl_mem cmScratch;
+        size_t scratch_points;
+        size_t tile;
+        char* cSourceCL;
+};
+
+#endif
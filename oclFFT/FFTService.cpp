@@ -0,0 +1,503 @@
+#include "FFTService.h"
+#include "oclFFT.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVICE_MAX_POINTS (1 << 22)
+// float2 points of one batched launch (128 MB), whatever max_batch allows
+#define SERVICE_MAX_BATCH_POINTS (1 << 24)
+// received and not yet answered per client: two of the largest requests
+#define SERVICE_MAX_CLIENT_BYTES (2 * (sizeof(ServiceRequestHeader) + 2 * sizeof(float) * (size_t)SERVICE_MAX_POINTS))
+
+using namespace std;
+
+static double wallclock(void)
+{
+  struct timeval tim;
+  gettimeofday(&tim, NULL);
+  return (double)tim.tv_sec*1000000 + (double)tim.tv_usec;
+}
+
+static void append(vector<char>& out, const void *buf, size_t bytes)
+{
+  const char *p = (const char *)buf;
+  out.insert(out.end(), p, p + bytes);
+}
+
+static size_t bitReverse(size_t i, size_t n)
+{
+  size_t rev = 0;
+  for(size_t m = n; m > 1; m >>= 1)
+  {
+    rev = (rev << 1) | (i & 1);
+    i >>= 1;
+  }
+  return rev;
+}
+
+FFTService::FFTService(Convolver& conv, cl_context cxContext, cl_command_queue cqCommandQueue, const char *socket_path,
+                       int window_us, size_t max_batch, int argc, const char **argv)
+    : conv(conv), cxContext(cxContext), cqCommandQueue(cqCommandQueue),
+      socket_path(socket_path, socket_path + strlen(socket_path) + 1), window_us(window_us),
+      max_batch(max_batch > 0 ? max_batch : 1), stopping(false), cmBatch(NULL), batch_capacity(0)
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(strlen(socket_path) >= sizeof(addr.sun_path))
+  {
+    shrLog("Socket path too long: %s\n", socket_path);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  strcpy(addr.sun_path, socket_path);
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path);
+  if(listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, SOMAXCONN) != 0)
+  {
+    shrLog("Error in bind/listen on %s: %s, Line %u in file %s !!!\n\n", socket_path, strerror(errno), __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
+
+FFTService::~FFTService()
+{
+  for(size_t i = 0; i < clients.size(); i++)
+    close(clients[i].fd);
+  if(listen_fd >= 0)
+  {
+    close(listen_fd);
+    unlink(&socket_path[0]);
+  }
+  if(cmBatch)clReleaseMemObject(cmBatch);
+}
+
+void FFTService::run(int argc, const char **argv)
+{
+  shrLog("Serving on %s, batch window %d us\n", &socket_path[0], window_us);
+  double first_pending = 0.0;
+  stopping = false;
+  while(!stopping || !pending.empty())
+  {
+    // wait for traffic, but no longer than the oldest pending request may be held back
+    int timeout_ms = -1;
+    if(stopping)
+      timeout_ms = 0;
+    else if(!pending.empty())
+    {
+      double left_us = window_us - (wallclock() - first_pending);
+      timeout_ms = left_us > 0.0 ? (int)((left_us + 999.0) / 1000.0) : 0;
+    }
+
+    vector<struct pollfd> fds(clients.size() + 1);
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    for(size_t i = 0; i < clients.size(); i++)
+    {
+      fds[i + 1].fd = clients[i].fd;
+      fds[i + 1].events = (accepting(clients[i]) ? POLLIN : 0) | (clients[i].output.empty() ? 0 : POLLOUT);
+    }
+    int ready = poll(&fds[0], fds.size(), timeout_ms);
+    if(ready < 0 && errno != EINTR)
+    {
+      shrLog("Error in poll: %s, Line %u in file %s !!!\n\n", strerror(errno), __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    if(ready > 0)
+    {
+      if(fds[0].revents & POLLIN)
+      {
+        int fd = accept(listen_fd, NULL, NULL);
+        if(fd >= 0)
+        {
+          fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+          Connection c;
+          c.fd = fd;
+          c.queued_bytes = 0;
+          c.closing = false;
+          clients.push_back(c);
+        }
+      }
+      // by descriptor: a client handled earlier in the pass may have been dropped
+      for(size_t i = 1; i < fds.size(); i++)
+      {
+        if(fds[i].revents & POLLOUT)
+          sendOutput(fds[i].fd);
+        if(fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+          bool was_idle = pending.empty();
+          receive(fds[i].fd);
+          if(was_idle && !pending.empty())
+            first_pending = wallclock();
+        }
+      }
+    }
+
+    if(!pending.empty() && (stopping || pending.size() >= max_batch || wallclock() - first_pending >= window_us))
+      flush(argc, argv);
+  }
+
+  // shutting down: the replies still queued go out before the sockets close
+  vector<int> remaining;
+  for(size_t i = 0; i < clients.size(); i++)
+  {
+    if(!clients[i].output.empty())
+      remaining.push_back(clients[i].fd);
+  }
+  for(size_t i = 0; i < remaining.size(); i++)
+  {
+    fcntl(remaining[i], F_SETFL, fcntl(remaining[i], F_GETFL, 0) & ~O_NONBLOCK);
+    sendOutput(remaining[i]);
+  }
+}
+
+FFTService::Connection *FFTService::connection(int fd)
+{
+  for(size_t i = 0; i < clients.size(); i++)
+  {
+    if(clients[i].fd == fd)
+      return &clients[i];
+  }
+  return NULL;
+}
+
+bool FFTService::accepting(const Connection &c) const
+{
+  return !c.closing && c.input.size() + c.queued_bytes < SERVICE_MAX_CLIENT_BYTES;
+}
+
+void FFTService::receive(int fd)
+{
+  Connection *c = connection(fd);
+  if(c == NULL || c->closing)
+    return;
+
+  // whatever has arrived, without waiting for the rest, up to the client's allowance;
+  // the allowance holds a whole request, so a partial one can always complete
+  char chunk[65536];
+  while(accepting(*c))
+  {
+    ssize_t got = read(fd, chunk, sizeof(chunk));
+    if(got < 0 && errno == EINTR)
+      continue;
+    if(got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if(got <= 0)
+    {
+      disconnect(fd);
+      return;
+    }
+    append(c->input, chunk, got);
+  }
+
+  size_t used = 0;
+  while(c->input.size() - used >= sizeof(ServiceRequestHeader))
+  {
+    Pending request;
+    request.fd = fd;
+    request.status = CL_SUCCESS;
+    request.last = false;
+    memcpy(&request.header, &c->input[used], sizeof(request.header));
+
+    const ServiceRequestHeader& h = request.header;
+    size_t payload = 0;
+    switch(h.op)
+    {
+      case SERVICE_SHUTDOWN:
+        stopping = true;
+        used += sizeof(h);
+        continue;
+      case SERVICE_FFT:
+        if(h.n < 2 || h.n > SERVICE_MAX_POINTS || (h.n & (h.n - 1)) != 0 || (h.dir != 1 && h.dir != -1))
+          request.status = CL_INVALID_VALUE;
+        payload = 2 * (size_t)h.n;
+        break;
+      case SERVICE_CONVOLVE:
+        if(h.n < 1 || h.len_b < 1 || (size_t)h.n + h.len_b - 1 > SERVICE_MAX_POINTS)
+          request.status = CL_INVALID_VALUE;
+        payload = (size_t)h.n + h.len_b;
+        break;
+      default:
+        request.status = CL_INVALID_VALUE;
+    }
+
+    // past a malformed header the stream can't be followed: answer it, then hang up
+    if(request.status != CL_SUCCESS)
+    {
+      request.last = true;
+      c->closing = true;
+      c->input.clear();
+      pending.push_back(request);
+      return;
+    }
+
+    // queued only once the whole payload is here
+    size_t bytes = sizeof(h) + sizeof(float) * payload;
+    if(c->input.size() - used < bytes)
+      break;
+    request.data.resize(payload);
+    memcpy(&request.data[0], &c->input[used + sizeof(h)], sizeof(float) * payload);
+    used += bytes;
+    c->queued_bytes += bytes;
+    pending.push_back(request);
+  }
+  c->input.erase(c->input.begin(), c->input.begin() + used);
+}
+
+// MSG_NOSIGNAL: a client that hung up must not take the server down with SIGPIPE
+void FFTService::sendOutput(int fd)
+{
+  Connection *c = connection(fd);
+  if(c == NULL)
+    return;
+  size_t sent = 0;
+  while(sent < c->output.size())
+  {
+    ssize_t n = send(fd, &c->output[sent], c->output.size() - sent, MSG_NOSIGNAL);
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if(n <= 0)
+    {
+      disconnect(fd);
+      return;
+    }
+    sent += n;
+  }
+  c->output.erase(c->output.begin(), c->output.begin() + sent);
+  if(c->closing && c->output.empty())
+    disconnect(fd);
+}
+
+void FFTService::disconnect(int fd)
+{
+  close(fd);
+  for(size_t i = 0; i < clients.size(); i++)
+  {
+    if(clients[i].fd == fd)
+    {
+      clients.erase(clients.begin() + i);
+      break;
+    }
+  }
+  for(size_t i = pending.size(); i > 0; i--)
+  {
+    if(pending[i - 1].fd == fd)
+      pending.erase(pending.begin() + (i - 1));
+  }
+}
+
+void FFTService::flush(int argc, const char **argv)
+{
+  vector<Pending> requests;
+  requests.swap(pending);
+  for(size_t i = 0; i < clients.size(); i++)
+    clients[i].queued_bytes = 0;
+
+  // group by what one batched launch can share: the operation, the transform size and the direction
+  vector<bool> batched(requests.size(), false);
+  for(size_t i = 0; i < requests.size(); i++)
+  {
+    if(batched[i] || requests[i].status != CL_SUCCESS)
+      continue;
+    const ServiceRequestHeader& h = requests[i].header;
+    size_t size = (h.op == SERVICE_FFT) ? h.n : Convolver::transformSize(h.n + h.len_b - 1);
+    // a convolution takes two rows; SERVICE_MAX_POINTS keeps a single request within the cap
+    size_t row_points = (h.op == SERVICE_FFT) ? size : 2 * size;
+    size_t rows_per_launch = max((size_t)1, min(max_batch, (size_t)SERVICE_MAX_BATCH_POINTS / row_points));
+
+    vector<Pending *> batch;
+    for(size_t j = i; j < requests.size(); j++)
+    {
+      const ServiceRequestHeader& o = requests[j].header;
+      if(batched[j] || requests[j].status != CL_SUCCESS || o.op != h.op)
+        continue;
+      if(o.op == SERVICE_FFT ? (o.n != h.n || o.dir != h.dir) : Convolver::transformSize(o.n + o.len_b - 1) != size)
+        continue;
+      batched[j] = true;
+      batch.push_back(&requests[j]);
+      if(batch.size() == rows_per_launch)
+      {
+        launch(h.op, batch, argc, argv);
+        batch.clear();
+      }
+    }
+    if(!batch.empty())
+      launch(h.op, batch, argc, argv);
+  }
+
+  // replies in arrival order, which keeps every connection's answers in its request order;
+  // they are queued on the connection and sent as far as each socket takes them now
+  vector<int> replied;
+  for(size_t i = 0; i < requests.size(); i++)
+  {
+    Connection *c = connection(requests[i].fd);
+    if(c == NULL)
+      continue;
+    ServiceResponseHeader reply;
+    reply.status = requests[i].status;
+    reply.count = (reply.status == CL_SUCCESS) ? (cl_uint)requests[i].data.size() : 0;
+    append(c->output, &reply, sizeof(reply));
+    if(reply.count > 0)
+      append(c->output, &requests[i].data[0], sizeof(float) * reply.count);
+    if(replied.empty() || replied.back() != requests[i].fd)
+      replied.push_back(requests[i].fd);
+  }
+  for(size_t i = 0; i < replied.size(); i++)
+    sendOutput(replied[i]);
+}
+
+void FFTService::launch(cl_uint op, const vector<Pending *>& batch, int argc, const char **argv)
+{
+  if(op == SERVICE_FFT)
+    runTransforms(batch, argc, argv);
+  else
+    runConvolutions(batch, argc, argv);
+  TRACE_TIMING(("Service batch: op %u, size %u, %u requests, status %d\n", op, batch[0]->header.n,
+                (unsigned int)batch.size(), batch[0]->status));
+}
+
+// Each request is a row of one buffer; one forward pass covers them all.
+void FFTService::runTransforms(const vector<Pending *>& batch, int argc, const char **argv)
+{
+  size_t n = batch[0]->header.n;
+  cl_int dir = batch[0]->header.dir;
+  size_t rows = batch.size();
+  cl_int ciErr = reserve(rows * n);
+  if (ciErr != CL_SUCCESS)
+  {
+    failBatch(batch, ciErr);
+    return;
+  }
+
+  vector<cl_float2> host(rows * n);
+  for(size_t r = 0; r < rows; r++)
+  {
+    const vector<float>& in = batch[r]->data;
+    for(size_t i = 0; i < n; i++)
+    {
+      host[r * n + i].x = in[2 * i];
+      host[r * n + i].y = in[2 * i + 1];
+    }
+  }
+
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmBatch, CL_FALSE, 0, sizeof(cl_float2) * rows * n, &host[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    failBatch(batch, ciErr);
+    return;
+  }
+  conv.forward(cmBatch, n, rows, argc, argv, dir);
+  ciErr = clEnqueueReadBuffer(cqCommandQueue, cmBatch, CL_TRUE, 0, sizeof(cl_float2) * rows * n, &host[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    failBatch(batch, ciErr);
+    return;
+  }
+
+  // forward leaves every row bit reversed; the scaling follows FFT (1/n on the forward transform)
+  float scale = (dir == 1) ? 1.0f / n : 1.0f;
+  for(size_t r = 0; r < rows; r++)
+  {
+    vector<float>& out = batch[r]->data;
+    for(size_t i = 0; i < n; i++)
+    {
+      const cl_float2& v = host[r * n + bitReverse(i, n)];
+      out[2 * i] = v.x * scale;
+      out[2 * i + 1] = v.y * scale;
+    }
+  }
+}
+
+// Rows 0..k-1 hold the a operands and rows k..2k-1 the b operands, as in Convolver::convolve
+// with k pairs instead of one.
+void FFTService::runConvolutions(const vector<Pending *>& batch, int argc, const char **argv)
+{
+  const ServiceRequestHeader& h = batch[0]->header;
+  size_t n = Convolver::transformSize(h.n + h.len_b - 1);
+  size_t k = batch.size();
+  cl_int ciErr = reserve(2 * k * n);
+  if (ciErr != CL_SUCCESS)
+  {
+    failBatch(batch, ciErr);
+    return;
+  }
+
+  vector<cl_float2> host(2 * k * n);
+  for(size_t i = 0; i < host.size(); i++)
+    host[i].x = host[i].y = 0.0f;
+  size_t longest_operand = 0, longest_result = 0;
+  for(size_t r = 0; r < k; r++)
+  {
+    const ServiceRequestHeader& o = batch[r]->header;
+    const vector<float>& in = batch[r]->data;
+    for(size_t i = 0; i < o.n; i++)
+      host[r * n + i].x = in[i];
+    for(size_t i = 0; i < o.len_b; i++)
+      host[(k + r) * n + i].x = in[o.n + i];
+    longest_operand = max(longest_operand, (size_t)max(o.n, o.len_b));
+    longest_result = max(longest_result, (size_t)(o.n + o.len_b - 1));
+  }
+
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmBatch, CL_FALSE, 0, sizeof(cl_float2) * 2 * k * n, &host[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    failBatch(batch, ciErr);
+    return;
+  }
+  conv.forward(cmBatch, n, 2 * k, argc, argv, 1, longest_operand);
+  conv.multiply(cmBatch, cmBatch, k * n, k * n, k * n, 1.0f / n, argc, argv);
+  conv.inverse(cmBatch, n, k, argc, argv, longest_result);
+  ciErr = clEnqueueReadBuffer(cqCommandQueue, cmBatch, CL_TRUE, 0, sizeof(cl_float2) * k * n, &host[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    failBatch(batch, ciErr);
+    return;
+  }
+
+  for(size_t r = 0; r < k; r++)
+  {
+    const ServiceRequestHeader& o = batch[r]->header;
+    vector<float>& out = batch[r]->data;
+    out.resize(o.n + o.len_b - 1);
+    for(size_t i = 0; i < out.size(); i++)
+      out[i] = host[r * n + i].x;
+  }
+}
+
+cl_int FFTService::reserve(size_t points)
+{
+  if(points <= batch_capacity)
+    return CL_SUCCESS;
+
+  cl_int ciErr;
+  if(cmBatch)clReleaseMemObject(cmBatch);
+  batch_capacity = 0;
+  cmBatch = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * points, NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    // this batch fails, the server and the other batches carry on
+    shrLog("Service: no device buffer for %u points: %s\n", (unsigned int)points, oclErrorString(ciErr));
+    cmBatch = NULL;
+    return ciErr;
+  }
+  batch_capacity = points;
+  return CL_SUCCESS;
+}
+
+void FFTService::failBatch(const vector<Pending *>& batch, cl_int status)
+{
+  for(size_t r = 0; r < batch.size(); r++)
+    batch[r]->status = status;
+}
@@ -0,0 +1,108 @@
+#ifndef _FFTSERVICE_H_
+#define _FFTSERVICE_H_
+
+#include <oclUtils.h>
+#include <vector>
+#include "Convolver.h"
+
+/* Operations of the service protocol. */
+enum ServiceOp
+{
+    SERVICE_SHUTDOWN = 0,   /* no payload, no reply: the server stops after the current batch */
+    SERVICE_FFT = 1,        /* n complex points in, n out; dir 1 forward (scaled by 1/n like FFT), -1 inverse */
+    SERVICE_CONVOLVE = 2    /* n real points of a then len_b of b in, n + len_b - 1 real coefficients out */
+};
+
+/* Every request is this header followed by its payload, all floats in host byte order
+   (complex points as re, im pairs). Requests on one connection are answered in order. */
+struct ServiceRequestHeader
+{
+    cl_uint op;
+    cl_uint n;          /* SERVICE_FFT: power of 2 from 2 up; SERVICE_CONVOLVE: length of a */
+    cl_uint len_b;      /* SERVICE_CONVOLVE only */
+    cl_int dir;         /* SERVICE_FFT only */
+};
+
+/* Every reply: status, then count floats. status is CL_SUCCESS, CL_INVALID_VALUE for a
+   malformed request (the server hangs up after it), or the OpenCL error the request's
+   batch failed with, such as CL_MEM_OBJECT_ALLOCATION_FAILURE (the connection stays). */
+struct ServiceResponseHeader
+{
+    cl_int status;
+    cl_uint count;
+};
+
+/* Long-running transform and convolution server on a Unix domain socket. OpenCL
+   and the programs are set up once for the process; requests arriving within
+   window_us of the first pending one are grouped by operation and transform size,
+   and every group runs in batched passes of the Convolver kernels, each of at most
+   max_batch requests and SERVICE_MAX_BATCH_POINTS points. Client sockets are
+   non-blocking: a request is only queued once all of it has arrived and replies go
+   out as the client takes them, so a slow or stalled client holds up nobody else.
+   A client with SERVICE_MAX_CLIENT_BYTES received but not yet answered isn't read
+   from again until the pending batch has run. */
+class FFTService
+{
+    public:
+        /* Listens on socket_path, replacing a stale socket file. */
+        FFTService(Convolver& conv, cl_context cxContext, cl_command_queue cqCommandQueue, const char *socket_path,
+                   int window_us, size_t max_batch, int argc, const char **argv);
+        ~FFTService();
+
+        /* Serves until a SERVICE_SHUTDOWN request. */
+        void run(int argc, const char **argv);
+
+    private:
+        struct Pending
+        {
+            int fd;
+            ServiceRequestHeader header;
+            std::vector<float> data;        /* the payload, replaced by the reply */
+            cl_int status;
+            bool last;                      /* malformed: the connection is closed after the reply */
+        };
+
+        struct Connection
+        {
+            int fd;
+            std::vector<char> input;        /* received bytes not yet making up a whole request */
+            std::vector<char> output;       /* reply bytes the socket hasn't taken yet */
+            size_t queued_bytes;            /* payload of its requests waiting in pending */
+            bool closing;                   /* malformed request: no more reads, hang up once output is sent */
+        };
+
+        Convolver& conv;
+        cl_context cxContext;
+        cl_command_queue cqCommandQueue;
+        std::vector<char> socket_path;
+        int listen_fd;
+        int window_us;
+        size_t max_batch;
+        std::vector<Connection> clients;
+        std::vector<Pending> pending;
+        bool stopping;
+        cl_mem cmBatch;
+        size_t batch_capacity;      /* float2 points of cmBatch */
+
+        Connection *connection(int fd);
+        /* False while c has as much data held as it is allowed. */
+        bool accepting(const Connection &c) const;
+        /* Reads what fd has and queues every request that is complete, dropping the
+           client if it has gone away. */
+        void receive(int fd);
+        /* Sends as much of fd's output as the socket takes, closing a finished closing client. */
+        void sendOutput(int fd);
+        /* Closes fd and forgets its pending requests. */
+        void disconnect(int fd);
+        /* Runs every pending request in launches per (op, size), and replies in arrival order. */
+        void flush(int argc, const char **argv);
+        /* One launch; a failure is the status of every request in it. */
+        void launch(cl_uint op, const std::vector<Pending *>& batch, int argc, const char **argv);
+        void runTransforms(const std::vector<Pending *>& batch, int argc, const char **argv);
+        void runConvolutions(const std::vector<Pending *>& batch, int argc, const char **argv);
+        /* Grows cmBatch to points, returning the OpenCL error if the device can't. */
+        cl_int reserve(size_t points);
+        static void failBatch(const std::vector<Pending *>& batch, cl_int status);
+};
+
+#endif
@@ -0,0 +1,62 @@
+// Number-theoretic transform stages modulo a prime p < 2^30.
+// Residues stay in [0, p); twiddles are stored in Montgomery form (w * 2^32 mod p)
+// so that mont_mul(x, w) is the plain product x * w mod p.
+
+uint mont_mul(uint a, uint b, uint p, uint pinv)
+{
+  uint lo = a * b;
+  uint hi = mul_hi(a, b);
+  uint m = lo * pinv;
+  uint mp = mul_hi(m, p);
+  return (hi < mp) ? hi - mp + p : hi - mp;
+}
+
+uint add_mod(uint a, uint b, uint p)
+{
+  uint s = a + b;
+  return (s >= p) ? s - p : s;
+}
+
+uint sub_mod(uint a, uint b, uint p)
+{
+  return (a >= b) ? a - b : a + p - b;
+}
+
+// one decimation-in-frequency stage of span 2*half, one butterfly per work-item
+__kernel void NTT_DIF_STAGE(__global uint * a, __global const uint * twiddles, const uint half, const uint p, const uint pinv)
+{
+  uint g = get_global_id(0);
+  uint j = g & (half - 1);
+  uint k = (g - j) << 1;
+
+  uint u = a[k + j];
+  uint v = a[k + j + half];
+  a[k + j] = add_mod(u, v, p);
+  a[k + j + half] = mont_mul(sub_mod(u, v, p), twiddles[half + j], p, pinv);
+}
+
+// one decimation-in-time stage of span 2*half, one butterfly per work-item
+__kernel void NTT_DIT_STAGE(__global uint * a, __global const uint * twiddles, const uint half, const uint p, const uint pinv)
+{
+  uint g = get_global_id(0);
+  uint j = g & (half - 1);
+  uint k = (g - j) << 1;
+
+  uint u = a[k + j];
+  uint v = mont_mul(a[k + j + half], twiddles[half + j], p, pinv);
+  a[k + j] = add_mod(u, v, p);
+  a[k + j + half] = sub_mod(u, v, p);
+}
+
+// a = a * b / 2^32, the 2^-32 is folded into the final scale
+__kernel void NTT_POINTWISE(__global uint * a, __global const uint * b, const uint p, const uint pinv)
+{
+  uint i = get_global_id(0);
+  a[i] = mont_mul(a[i], b[i], p, pinv);
+}
+
+__kernel void NTT_SCALE(__global uint * a, const uint c, const uint p, const uint pinv)
+{
+  uint i = get_global_id(0);
+  a[i] = mont_mul(a[i], c, p, pinv);
+}
@@ -0,0 +1,566 @@
+#include "NTT.h"
+#include "oclFFT.h"
+#include "CpuEngine.h"
+#include <cstdlib>
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// 119*2^23+1, 5*2^25+1 and 7*2^26+1, all with primitive root 3
+static const cl_uint prime_values[NTT_NUM_PRIMES] = { 998244353u, 167772161u, 469762049u };
+
+static cl_uint powMod(cl_ulong b, cl_ulong e, cl_uint p)
+{
+  cl_ulong r = 1;
+  b %= p;
+  while(e > 0)
+  {
+    if(e & 1)
+      r = r * b % p;
+    b = b * b % p;
+    e >>= 1;
+  }
+  return (cl_uint)r;
+}
+
+static cl_uint inverseMod(cl_ulong a, cl_uint p)
+{
+  return powMod(a, p - 2, p);
+}
+
+static NTTPrime makePrime(cl_uint p)
+{
+  NTTPrime prime;
+  prime.p = p;
+  prime.generator = 3;
+  // Newton iteration doubles the correct low bits of p^-1 mod 2^32 each step
+  cl_uint inv = p;
+  for(int i = 0; i < 4; i++)
+    inv *= 2 - p * inv;
+  prime.pinv = inv;
+  cl_ulong r = ((cl_ulong)1 << 32) % p;
+  prime.r2 = (cl_uint)(r * r % p);
+  return prime;
+}
+
+static inline cl_uint montMul(cl_uint a, cl_uint b, cl_uint p, cl_uint pinv)
+{
+  cl_ulong ab = (cl_ulong)a * b;
+  cl_uint m = (cl_uint)ab * pinv;
+  cl_uint hi = (cl_uint)(ab >> 32);
+  cl_uint mp = (cl_uint)(((cl_ulong)m * p) >> 32);
+  return (hi < mp) ? hi - mp + p : hi - mp;
+}
+
+const NTTPrime& NTT::prime(int i)
+{
+  static const NTTPrime primes[NTT_NUM_PRIMES] =
+  {
+    makePrime(prime_values[0]), makePrime(prime_values[1]), makePrime(prime_values[2])
+  };
+  return primes[i];
+}
+
+int NTT::primesNeeded(const vector<long long>& a, const vector<long long>& b)
+{
+  long double max_a = 0, max_b = 0;
+  for(size_t i = 0; i < a.size(); i++)
+    max_a = max(max_a, (long double)llabs(a[i]));
+  for(size_t i = 0; i < b.size(); i++)
+    max_b = max(max_b, (long double)llabs(b[i]));
+  long double bound = 2 * max_a * max_b * (long double)min(a.size(), b.size());
+
+  long double modulus = 1;
+  for(int i = 0; i < NTT_NUM_PRIMES; i++)
+  {
+    modulus *= prime_values[i];
+    if(bound < modulus)
+      return i + 1;
+  }
+  shrLog("NTT: coefficients may exceed the CRT range, results are not exact\n");
+  return NTT_NUM_PRIMES;
+}
+
+void NTT::twiddles(const NTTPrime& prime, int n, int dir, vector<cl_uint>& table)
+{
+  table.assign(n > 1 ? n : 2, 0);
+  for(int h = 1; h < n; h <<= 1)
+  {
+    cl_uint w = powMod(prime.generator, (prime.p - 1) / (2 * h), prime.p);
+    if(dir < 0)
+      w = inverseMod(w, prime.p);
+    cl_uint w_mont = montMul(w, prime.r2, prime.p, prime.pinv);
+    cl_uint cur = montMul(1, prime.r2, prime.p, prime.pinv);
+    for(int j = 0; j < h; j++)
+    {
+      table[h + j] = cur;
+      cur = montMul(cur, w_mont, prime.p, prime.pinv);
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// host transforms
+
+#ifdef __SSE2__
+// four Montgomery products at once; every value is below 2^30 so signed compares are safe
+static inline __m128i montMul4(__m128i a, __m128i b, __m128i p, __m128i pinv)
+{
+  __m128i ab_even = _mm_mul_epu32(a, b);
+  __m128i ab_odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  __m128i mp_even = _mm_mul_epu32(_mm_mul_epu32(ab_even, pinv), p);
+  __m128i mp_odd = _mm_mul_epu32(_mm_mul_epu32(ab_odd, pinv), p);
+  __m128i t_even = _mm_sub_epi64(_mm_srli_epi64(ab_even, 32), _mm_srli_epi64(mp_even, 32));
+  __m128i t_odd = _mm_sub_epi64(_mm_srli_epi64(ab_odd, 32), _mm_srli_epi64(mp_odd, 32));
+  __m128i t = _mm_or_si128(_mm_and_si128(t_even, _mm_set_epi32(0, -1, 0, -1)), _mm_slli_epi64(t_odd, 32));
+  return _mm_add_epi32(t, _mm_and_si128(_mm_srai_epi32(t, 31), p));
+}
+
+static inline __m128i addMod4(__m128i a, __m128i b, __m128i p, __m128i p_minus_1)
+{
+  __m128i s = _mm_add_epi32(a, b);
+  return _mm_sub_epi32(s, _mm_and_si128(_mm_cmpgt_epi32(s, p_minus_1), p));
+}
+
+static inline __m128i subMod4(__m128i a, __m128i b, __m128i p)
+{
+  __m128i d = _mm_sub_epi32(a, b);
+  return _mm_add_epi32(d, _mm_and_si128(_mm_srai_epi32(d, 31), p));
+}
+#endif
+
+static inline cl_uint addMod(cl_uint a, cl_uint b, cl_uint p)
+{
+  cl_uint s = a + b;
+  return (s >= p) ? s - p : s;
+}
+
+static inline cl_uint subMod(cl_uint a, cl_uint b, cl_uint p)
+{
+  return (a >= b) ? a - b : a + p - b;
+}
+
+// x[j] = x[j] + y[j], y[j] = (x[j] - y[j]) * w[j] for j in [j0, j1)
+static void difButterflies(cl_uint *x, cl_uint *y, const cl_uint *w, size_t j0, size_t j1, const NTTPrime& pr)
+{
+  size_t j = j0;
+#ifdef __SSE2__
+  const __m128i p = _mm_set1_epi32(pr.p), p_minus_1 = _mm_set1_epi32(pr.p - 1), pinv = _mm_set1_epi32(pr.pinv);
+  for(; j + 4 <= j1; j += 4)
+  {
+    __m128i u = _mm_loadu_si128((const __m128i *)(x + j));
+    __m128i v = _mm_loadu_si128((const __m128i *)(y + j));
+    __m128i tw = _mm_loadu_si128((const __m128i *)(w + j));
+    _mm_storeu_si128((__m128i *)(x + j), addMod4(u, v, p, p_minus_1));
+    _mm_storeu_si128((__m128i *)(y + j), montMul4(subMod4(u, v, p), tw, p, pinv));
+  }
+#endif
+  for(; j < j1; j++)
+  {
+    cl_uint u = x[j], v = y[j];
+    x[j] = addMod(u, v, pr.p);
+    y[j] = montMul(subMod(u, v, pr.p), w[j], pr.p, pr.pinv);
+  }
+}
+
+// v = y[j] * w[j], x[j] = x[j] + v, y[j] = x[j] - v for j in [j0, j1)
+static void ditButterflies(cl_uint *x, cl_uint *y, const cl_uint *w, size_t j0, size_t j1, const NTTPrime& pr)
+{
+  size_t j = j0;
+#ifdef __SSE2__
+  const __m128i p = _mm_set1_epi32(pr.p), p_minus_1 = _mm_set1_epi32(pr.p - 1), pinv = _mm_set1_epi32(pr.pinv);
+  for(; j + 4 <= j1; j += 4)
+  {
+    __m128i u = _mm_loadu_si128((const __m128i *)(x + j));
+    __m128i v = montMul4(_mm_loadu_si128((const __m128i *)(y + j)), _mm_loadu_si128((const __m128i *)(w + j)), p, pinv);
+    _mm_storeu_si128((__m128i *)(x + j), addMod4(u, v, p, p_minus_1));
+    _mm_storeu_si128((__m128i *)(y + j), subMod4(u, v, p));
+  }
+#endif
+  for(; j < j1; j++)
+  {
+    cl_uint u = x[j];
+    cl_uint v = montMul(y[j], w[j], pr.p, pr.pinv);
+    x[j] = addMod(u, v, pr.p);
+    y[j] = subMod(u, v, pr.p);
+  }
+}
+
+struct NTTJob
+{
+    cl_uint *a;
+    const cl_uint *b;
+    const cl_uint *table;
+    NTTPrime prime;
+    size_t half;        // stage of a striped job
+    size_t span;        // block size of a blocked job
+    bool dif;
+    cl_uint scale;
+};
+
+static void nttStripe(void *arg, size_t first, size_t last)
+{
+  NTTJob *job = (NTTJob *)arg;
+  size_t half = job->half;
+  while(first < last)
+  {
+    size_t k = (first / half) * 2 * half;
+    size_t j0 = first % half;
+    size_t j1 = (last - first < half - j0) ? j0 + (last - first) : half;
+    if(job->dif)
+      difButterflies(job->a + k, job->a + k + half, job->table + half, j0, j1, job->prime);
+    else
+      ditButterflies(job->a + k, job->a + k + half, job->table + half, j0, j1, job->prime);
+    first += j1 - j0;
+  }
+}
+
+static void nttBlocks(void *arg, size_t first, size_t last)
+{
+  NTTJob *job = (NTTJob *)arg;
+  for(size_t blk = first; blk < last; blk++)
+  {
+    cl_uint *base = job->a + blk * job->span;
+    if(job->dif)
+    {
+      for(size_t half = job->span / 2; half >= 1; half >>= 1)
+        for(size_t k = 0; k < job->span; k += 2 * half)
+          difButterflies(base + k, base + k + half, job->table + half, 0, half, job->prime);
+    }
+    else
+    {
+      for(size_t half = 1; half < job->span; half <<= 1)
+        for(size_t k = 0; k < job->span; k += 2 * half)
+          ditButterflies(base + k, base + k + half, job->table + half, 0, half, job->prime);
+    }
+  }
+}
+
+static void nttPointwise(void *arg, size_t first, size_t last)
+{
+  NTTJob *job = (NTTJob *)arg;
+  for(size_t i = first; i < last; i++)
+    job->a[i] = montMul(job->a[i], job->b[i], job->prime.p, job->prime.pinv);
+}
+
+static void nttScale(void *arg, size_t first, size_t last)
+{
+  NTTJob *job = (NTTJob *)arg;
+  for(size_t i = first; i < last; i++)
+    job->a[i] = montMul(job->a[i], job->scale, job->prime.p, job->prime.pinv);
+}
+
+// natural order in, bit reversed order out (dif), or the other way round (dit)
+static void transformHost(cl_uint *a, size_t n, const cl_uint *table, const NTTPrime& prime, bool dif)
+{
+  CpuEngine &engine = CpuEngine::shared();
+  NTTJob job;
+  job.a = a;
+  job.table = table;
+  job.prime = prime;
+  job.dif = dif;
+
+  // stages wide enough that there are fewer blocks than threads are split by butterfly
+  size_t span = n;
+  while(span > 1 && n / span < (size_t)engine.numThreads())
+    span >>= 1;
+
+  if(dif)
+  {
+    for(job.half = n / 2; job.half >= span && job.half >= 1; job.half >>= 1)
+      engine.parallelFor(n / 2, nttStripe, &job);
+    job.span = span;
+    if(span > 1)
+      engine.parallelFor(n / span, nttBlocks, &job);
+  }
+  else
+  {
+    job.span = span;
+    if(span > 1)
+      engine.parallelFor(n / span, nttBlocks, &job);
+    for(job.half = span; job.half < n; job.half <<= 1)
+      engine.parallelFor(n / 2, nttStripe, &job);
+  }
+}
+
+// 0 when the product needs more than NTT_MAX_POINTS points (the primes' 2^k limit)
+static size_t transformSize(const vector<long long>& a, const vector<long long>& b)
+{
+  size_t len = a.size() + b.size() - 1;
+  size_t n = 2;
+  while(n < len)
+    n <<= 1;
+  if(n > NTT_MAX_POINTS)
+  {
+    shrLog("NTT: a product of %u terms needs more than %u points\n", (unsigned int)len, NTT_MAX_POINTS);
+    return 0;
+  }
+  return n;
+}
+
+static void reduceInput(const vector<long long>& src, vector<cl_uint>& dest, size_t n, cl_uint p)
+{
+  dest.assign(n, 0);
+  for(size_t i = 0; i < src.size(); i++)
+  {
+    long long r = src[i] % (long long)p;
+    dest[i] = (cl_uint)(r < 0 ? r + p : r);
+  }
+}
+
+// n^-1 * 2^64 mod p: undoes the transform gain and the 2^-32 of the pointwise product
+static cl_uint finalScale(const NTTPrime& prime, size_t n)
+{
+  cl_uint ninv = inverseMod(n % prime.p, prime.p);
+  return montMul(montMul(ninv, prime.r2, prime.p, prime.pinv), prime.r2, prime.p, prime.pinv);
+}
+
+// Garner's mixed radix reconstruction, then mapped to the symmetric range
+static void reconstruct(const vector<vector<cl_uint> >& residues, int num_primes, size_t len, vector<long long>& out)
+{
+  cl_ulong p0 = prime_values[0], p1 = prime_values[1], p2 = prime_values[2];
+  cl_ulong inv_p0 = inverseMod(p0 % p1, p1);
+  cl_ulong h = p0 * p1;
+  cl_ulong inv_h = inverseMod(h % p2, p2);
+  cl_ulong m_wrapped = h * p2;     // p0*p1*p2 mod 2^64
+  cl_ulong q = (p2 - 1) / 2;
+
+  out.resize(len);
+  for(size_t i = 0; i < len; i++)
+  {
+    cl_ulong r0 = residues[0][i];
+    if(num_primes == 1)
+    {
+      out[i] = (r0 > p0 / 2) ? (long long)r0 - (long long)p0 : (long long)r0;
+      continue;
+    }
+
+    cl_ulong k1 = (residues[1][i] + p1 - r0 % p1) % p1 * inv_p0 % p1;
+    cl_ulong low = r0 + p0 * k1;
+    if(num_primes == 2)
+    {
+      out[i] = (low > h / 2) ? (long long)low - (long long)h : (long long)low;
+      continue;
+    }
+
+    cl_ulong k2 = (residues[2][i] + p2 - low % p2) % p2 * inv_h % p2;
+    cl_ulong x = low + h * k2;
+    if(k2 > q || (k2 == q && 2 * low > h))
+      x -= m_wrapped;
+    out[i] = (long long)x;
+  }
+}
+
+vector<long long> NTT::multiply(const vector<long long>& a, const vector<long long>& b)
+{
+  size_t n = transformSize(a, b);
+  if(n == 0)
+    return vector<long long>();
+  int num_primes = primesNeeded(a, b);
+  vector<vector<cl_uint> > residues(num_primes);
+  vector<cl_uint> b_values, forward, inverse;
+
+  for(int k = 0; k < num_primes; k++)
+  {
+    const NTTPrime& pr = prime(k);
+    vector<cl_uint>& a_values = residues[k];
+    reduceInput(a, a_values, n, pr.p);
+    reduceInput(b, b_values, n, pr.p);
+    twiddles(pr, n, 1, forward);
+    twiddles(pr, n, -1, inverse);
+
+    // DIF forward leaves both spectra bit reversed, the DIT inverse takes them back
+    // to natural order, so no explicit bit reversal is needed
+    transformHost(&a_values[0], n, &forward[0], pr, true);
+    transformHost(&b_values[0], n, &forward[0], pr, true);
+
+    NTTJob job;
+    job.a = &a_values[0];
+    job.b = &b_values[0];
+    job.prime = pr;
+    job.scale = finalScale(pr, n);
+    CpuEngine::shared().parallelFor(n, nttPointwise, &job);
+    transformHost(&a_values[0], n, &inverse[0], pr, false);
+    CpuEngine::shared().parallelFor(n, nttScale, &job);
+  }
+
+  vector<long long> c;
+  reconstruct(residues, num_primes, a.size() + b.size() - 1, c);
+  return c;
+}
+
+// ---------------------------------------------------------------------------
+// device transforms
+
+NTT::NTT(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue, int argc, const char **argv)
+    : cxContext(cxContext), cqCommandQueue(cqCommandQueue)
+{
+  cl_int ciErr;
+  size_t szKernelLength;
+  char* cPathAndName = shrFindFilePath("NTT.cl", argv[0]);
+  cSourceCL = oclLoadProgSource(cPathAndName, "", &szKernelLength);
+  free(cPathAndName);
+
+  cpProgram = clCreateProgramWithSource(cxContext, 1, (const char **)&cSourceCL, &szKernelLength, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateProgramWithSource, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  ciErr = clBuildProgram(cpProgram, 1, &cdDevice, NULL, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    size_t log_size;
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+    char* program_log = (char *)malloc(log_size + 1);
+    program_log[log_size] = '\0';
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, log_size + 1, program_log, NULL);
+    printf("%s\n", program_log);
+    free(program_log);
+    shrLog("Error in clBuildProgram, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ckDIF = clCreateKernel(cpProgram, "NTT_DIF_STAGE", &ciErr);
+  ckDIT = clCreateKernel(cpProgram, "NTT_DIT_STAGE", &ciErr);
+  ckPointwise = clCreateKernel(cpProgram, "NTT_POINTWISE", &ciErr);
+  ckScale = clCreateKernel(cpProgram, "NTT_SCALE", &ciErr);
+  // each call overwrites ciErr, but a failed one leaves its kernel NULL
+  if (ckDIF == NULL || ckDIT == NULL || ckPointwise == NULL || ckScale == NULL)
+  {
+    shrLog("Error in clCreateKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
+
+NTT::~NTT()
+{
+  if(ckScale)clReleaseKernel(ckScale);
+  if(ckPointwise)clReleaseKernel(ckPointwise);
+  if(ckDIT)clReleaseKernel(ckDIT);
+  if(ckDIF)clReleaseKernel(ckDIF);
+  if(cpProgram)clReleaseProgram(cpProgram);
+  if(cSourceCL)free(cSourceCL);
+}
+
+vector<long long> NTT::multiplyGPU(const vector<long long>& a, const vector<long long>& b, int argc, const char **argv)
+{
+  cl_int ciErr;
+  size_t n = transformSize(a, b);
+  if(n == 0)
+  {
+    shrLog("Error in NTT size, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  size_t szButterflies = n / 2;
+  int num_primes = primesNeeded(a, b);
+  vector<vector<cl_uint> > residues(num_primes);
+  vector<cl_uint> b_values, forward, inverse;
+
+  cl_mem cmA = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_uint) * n, NULL, &ciErr);
+  cl_mem cmB = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_uint) * n, NULL, &ciErr);
+  cl_mem cmForward = clCreateBuffer(cxContext, CL_MEM_READ_ONLY, sizeof(cl_uint) * n, NULL, &ciErr);
+  cl_mem cmInverse = clCreateBuffer(cxContext, CL_MEM_READ_ONLY, sizeof(cl_uint) * n, NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  for(int k = 0; k < num_primes; k++)
+  {
+    const NTTPrime& pr = prime(k);
+    vector<cl_uint>& a_values = residues[k];
+    reduceInput(a, a_values, n, pr.p);
+    reduceInput(b, b_values, n, pr.p);
+    twiddles(pr, n, 1, forward);
+    twiddles(pr, n, -1, inverse);
+    cl_uint scale = finalScale(pr, n);
+
+    ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmA, CL_FALSE, 0, sizeof(cl_uint) * n, &a_values[0], 0, NULL, NULL);
+    ciErr |= clEnqueueWriteBuffer(cqCommandQueue, cmB, CL_FALSE, 0, sizeof(cl_uint) * n, &b_values[0], 0, NULL, NULL);
+    ciErr |= clEnqueueWriteBuffer(cqCommandQueue, cmForward, CL_FALSE, 0, sizeof(cl_uint) * n, &forward[0], 0, NULL, NULL);
+    ciErr |= clEnqueueWriteBuffer(cqCommandQueue, cmInverse, CL_FALSE, 0, sizeof(cl_uint) * n, &inverse[0], 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    // forward DIF of both operands, stage by stage
+    for(cl_uint half = n / 2; half >= 1; half >>= 1)
+    {
+      for(int operand = 0; operand < 2; operand++)
+      {
+        ciErr = clSetKernelArg(ckDIF, 0, sizeof(cl_mem), (void*)(operand == 0 ? &cmA : &cmB));
+        ciErr |= clSetKernelArg(ckDIF, 1, sizeof(cl_mem), (void*)&cmForward);
+        ciErr |= clSetKernelArg(ckDIF, 2, sizeof(cl_uint), (void*)&half);
+        ciErr |= clSetKernelArg(ckDIF, 3, sizeof(cl_uint), (void*)&pr.p);
+        ciErr |= clSetKernelArg(ckDIF, 4, sizeof(cl_uint), (void*)&pr.pinv);
+        ciErr |= clEnqueueNDRangeKernel(cqCommandQueue, ckDIF, 1, NULL, &szButterflies, NULL, 0, NULL, NULL);
+        if (ciErr != CL_SUCCESS)
+        {
+          shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+          Cleanup(argc, (char **)argv, EXIT_FAILURE);
+        }
+      }
+    }
+
+    ciErr = clSetKernelArg(ckPointwise, 0, sizeof(cl_mem), (void*)&cmA);
+    ciErr |= clSetKernelArg(ckPointwise, 1, sizeof(cl_mem), (void*)&cmB);
+    ciErr |= clSetKernelArg(ckPointwise, 2, sizeof(cl_uint), (void*)&pr.p);
+    ciErr |= clSetKernelArg(ckPointwise, 3, sizeof(cl_uint), (void*)&pr.pinv);
+    ciErr |= clEnqueueNDRangeKernel(cqCommandQueue, ckPointwise, 1, NULL, &n, NULL, 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    // inverse DIT takes the bit reversed product back to natural order
+    for(cl_uint half = 1; half < n; half <<= 1)
+    {
+      ciErr = clSetKernelArg(ckDIT, 0, sizeof(cl_mem), (void*)&cmA);
+      ciErr |= clSetKernelArg(ckDIT, 1, sizeof(cl_mem), (void*)&cmInverse);
+      ciErr |= clSetKernelArg(ckDIT, 2, sizeof(cl_uint), (void*)&half);
+      ciErr |= clSetKernelArg(ckDIT, 3, sizeof(cl_uint), (void*)&pr.p);
+      ciErr |= clSetKernelArg(ckDIT, 4, sizeof(cl_uint), (void*)&pr.pinv);
+      ciErr |= clEnqueueNDRangeKernel(cqCommandQueue, ckDIT, 1, NULL, &szButterflies, NULL, 0, NULL, NULL);
+      if (ciErr != CL_SUCCESS)
+      {
+        shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+        Cleanup(argc, (char **)argv, EXIT_FAILURE);
+      }
+    }
+
+    ciErr = clSetKernelArg(ckScale, 0, sizeof(cl_mem), (void*)&cmA);
+    ciErr |= clSetKernelArg(ckScale, 1, sizeof(cl_uint), (void*)&scale);
+    ciErr |= clSetKernelArg(ckScale, 2, sizeof(cl_uint), (void*)&pr.p);
+    ciErr |= clSetKernelArg(ckScale, 3, sizeof(cl_uint), (void*)&pr.pinv);
+    ciErr |= clEnqueueNDRangeKernel(cqCommandQueue, ckScale, 1, NULL, &n, NULL, 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    ciErr = clEnqueueReadBuffer(cqCommandQueue, cmA, CL_TRUE, 0, sizeof(cl_uint) * n, &a_values[0], 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+  }
+
+  clReleaseMemObject(cmA);
+  clReleaseMemObject(cmB);
+  clReleaseMemObject(cmForward);
+  clReleaseMemObject(cmInverse);
+
+  vector<long long> c;
+  reconstruct(residues, num_primes, a.size() + b.size() - 1, c);
+  return c;
+}
@@ -0,0 +1,54 @@
+#ifndef _NTT_H_
+#define _NTT_H_
+
+#include <oclUtils.h>
+#include <vector>
+
+#define NTT_NUM_PRIMES 3
+#define NTT_MAX_POINTS (1 << 23)
+
+/* An NTT-friendly prime p = c*2^k + 1 with its Montgomery constants (R = 2^32). */
+struct NTTPrime
+{
+    cl_uint p;
+    cl_uint generator;
+    cl_uint pinv;       /* p^-1 mod 2^32 */
+    cl_uint r2;         /* R^2 mod p */
+};
+
+/* Exact integer convolution through number-theoretic transforms modulo up to
+   three primes below 2^30, recombined with the Chinese remainder theorem.
+   Results are exact as long as every product coefficient fits in a long long. */
+class NTT
+{
+    public:
+        /* Builds NTT.cl for the device behind cqCommandQueue. */
+        NTT(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue, int argc, const char **argv);
+        ~NTT();
+
+        /* Product of two integer polynomials on the host (threaded, SSE2 Montgomery butterflies).
+           Empty if the product has more than NTT_MAX_POINTS terms. */
+        static std::vector<long long> multiply(const std::vector<long long>& a, const std::vector<long long>& b);
+        /* Same product with the transforms and the pointwise step on the device; more than
+           NTT_MAX_POINTS terms is an error. */
+        std::vector<long long> multiplyGPU(const std::vector<long long>& a, const std::vector<long long>& b,
+                                           int argc, const char **argv);
+
+        static const NTTPrime& prime(int i);
+        /* Fewest primes whose product exceeds twice the largest possible coefficient. */
+        static int primesNeeded(const std::vector<long long>& a, const std::vector<long long>& b);
+        /* Forward (dir 1) or inverse (dir -1) twiddles in Montgomery form, entry j of span 2h at [h + j]. */
+        static void twiddles(const NTTPrime& prime, int n, int dir, std::vector<cl_uint>& table);
+
+    private:
+        cl_context cxContext;
+        cl_command_queue cqCommandQueue;
+        cl_program cpProgram;
+        cl_kernel ckDIF;
+        cl_kernel ckDIT;
+        cl_kernel ckPointwise;
+        cl_kernel ckScale;
+        char* cSourceCL;
+};
+
+#endif
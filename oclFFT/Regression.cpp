@@ -0,0 +1,337 @@
+#include "Regression.h"
+#include "oclFFT.h"
+#include "FFT.h"
+#include "DevicePlan.h"
+#include "PlanCache.h"
+#include "CodeletGen.h"
+#include "Convolver.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/time.h>
+
+#define REGRESS_RUNS 3
+#define REGRESS_DIRECT_MAX_LG 10
+#define REGRESS_ERROR_FACTOR 2.0
+#define REGRESS_SPEED_FACTOR 0.8
+
+using namespace std;
+
+typedef complex<long double> Exact;
+typedef complex<double> Point;
+
+static double wallclock(void)
+{
+  struct timeval tim;
+  gettimeofday(&tim, NULL);
+  return (double)tim.tv_sec*1000000 + (double)tim.tv_usec;
+}
+
+// Radix-2 in long double, every twiddle straight from cosl/sinl of its own angle.
+static vector<Exact> referenceTransform(const vector<Point> &input)
+{
+  size_t n = input.size();
+  int lg = 0;
+  while(((size_t)1 << lg) < n)
+    lg++;
+  vector<Exact> a(n);
+  for(size_t i = 0; i < n; i++)
+  {
+    size_t rev = 0;
+    for(int b = 0; b < lg; b++)
+      rev |= ((i >> b) & 1) << (lg - 1 - b);
+    a[rev] = Exact(input[i].real(), input[i].imag());
+  }
+
+  const long double pi = 3.141592653589793238462643383279502884L;
+  for(size_t half = 1; half < n; half <<= 1)
+  {
+    for(size_t j = 0; j < half; j++)
+    {
+      long double angle = -pi * j / half;
+      Exact w(cosl(angle), sinl(angle));
+      for(size_t k = j; k < n; k += half << 1)
+      {
+        Exact t = w * a[k + half];
+        a[k + half] = a[k] - t;
+        a[k] += t;
+      }
+    }
+  }
+  return a;
+}
+
+// The O(n^2) definition, only used to vouch for the reference at small n.
+static vector<Exact> directTransform(const vector<Point> &input)
+{
+  size_t n = input.size();
+  const long double pi = 3.141592653589793238462643383279502884L;
+  vector<Exact> out(n);
+  for(size_t k = 0; k < n; k++)
+  {
+    Exact sum = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+      // (i * k) mod n keeps the angle in one turn
+      long double angle = -2 * pi * ((i * k) % n) / n;
+      sum += Exact(input[i].real(), input[i].imag()) * Exact(cosl(angle), sinl(angle));
+    }
+    out[k] = sum;
+  }
+  return out;
+}
+
+// output is compared as output * scale, which undoes the 1/n of the FFT class exactly
+template <typename V>
+static RegressionResult measure(const string &engine, const vector<V> &output, long double scale,
+                                const vector<Exact> &ref, double microseconds)
+{
+  size_t n = ref.size();
+  long double diff2 = 0, ref2 = 0, max_diff = 0, max_ref = 0;
+  for(size_t i = 0; i < n; i++)
+  {
+    Exact x((long double)output[i].real() * scale, (long double)output[i].imag() * scale);
+    long double d = abs(x - ref[i]);
+    long double r = abs(ref[i]);
+    diff2 += d * d;
+    ref2 += r * r;
+    if(d > max_diff)
+      max_diff = d;
+    if(r > max_ref)
+      max_ref = r;
+  }
+
+  RegressionResult result;
+  result.engine = engine;
+  result.n = n;
+  result.rms = ref2 > 0 ? (double)sqrtl(diff2 / ref2) : 0.0;
+  result.max_error = max_ref > 0 ? (double)(max_diff / max_ref) : 0.0;
+  int lg = 0;
+  while(((size_t)1 << lg) < n)
+    lg++;
+  result.mflops = microseconds > 0 ? 5.0 * n * lg / microseconds : 0.0;
+  shrLog("%-10s %9u  rms %.3e  max %.3e  rms/log2n %.3e  %9.1f MFlops\n", engine.c_str(), (unsigned int)n,
+         result.rms, result.max_error, lg > 0 ? result.rms / lg : 0.0, result.mflops);
+  return result;
+}
+
+template <typename T>
+static RegressionResult hostEngine(const string &engine, const vector<Point> &input, const vector<Exact> &ref)
+{
+  size_t n = input.size();
+  vector<typename FFT<T>::Complex> in(n), out;
+  for(size_t i = 0; i < n; i++)
+    in[i] = typename FFT<T>::Complex((T)input[i].real(), (T)input[i].imag());
+  FFT<T> dft((int)n);
+  double best = -1.0;
+  for(int r = 0; r < REGRESS_RUNS; r++)
+  {
+    double t = wallclock();
+    out = dft.transform(in);
+    t = wallclock() - t;
+    if(best < 0.0 || t < best)
+      best = t;
+  }
+  return measure(engine, out, (long double)n, ref, best);
+}
+
+static RegressionResult deviceEngine(cl_context cxContext, cl_device_id cdDevice, const char *source, size_t source_length,
+                                     const vector<Point> &input, const vector<Exact> &ref, int argc, const char **argv)
+{
+  size_t n = input.size();
+  string binary_name;
+  cl_program cpProgram = buildFFTProgram(cxContext, cdDevice, source, source_length, n, FFTPrecision<float>::buildOptions(),
+                                         NULL, binary_name, argc, argv);
+
+  LaunchConfig config;
+  if(codeletPoints(n) == n)
+    config = codeletLaunchConfig(n);
+  else
+  {
+    cl_int ciErr;
+    size_t items_per_group;
+    cl_ulong local_memory_size;
+    cl_kernel ckKernel = clCreateKernel(cpProgram, "FFT2", &ciErr);
+    ciErr |= clGetKernelWorkGroupInfo(ckKernel, cdDevice, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), (void *)&items_per_group, NULL);
+    ciErr |= clGetDeviceInfo(cdDevice, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &local_memory_size, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clGetKernelWorkGroupInfo, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    clReleaseKernel(ckKernel);
+    config = defaultLaunchConfig(n, items_per_group, local_memory_size);
+  }
+
+  vector<FFT<float>::Complex> in(n);
+  for(size_t i = 0; i < n; i++)
+    in[i] = FFT<float>::Complex((float)input[i].real(), (float)input[i].imag());
+  vector<cl_float2> out(n);
+  double best = -1.0;
+  {
+    FFT<float> dft((int)n);
+    DevicePlan plan(cxContext, cdDevice, cpProgram, config, n, sizeof(cl_float2));
+    // the first run also creates this thread's queue and kernel, so it isn't timed
+    for(int r = 0; r <= REGRESS_RUNS; r++)
+    {
+      double t = wallclock();
+      dft.transformGPU(in, &out[0], plan, argc, argv);
+      t = wallclock() - t;
+      if(r > 0 && (best < 0.0 || t < best))
+        best = t;
+    }
+  }
+  clReleaseProgram(cpProgram);
+
+  vector<Point> values(n);
+  for(size_t i = 0; i < n; i++)
+    values[i] = Point(out[i].x, out[i].y);
+  return measure("device", values, (long double)n, ref, best);
+}
+
+static RegressionResult convolverEngine(Convolver &conv, cl_context cxContext, cl_command_queue cqCommandQueue,
+                                        const vector<Point> &input, const vector<Exact> &ref, int argc, const char **argv)
+{
+  size_t n = input.size();
+  vector<cl_float2> data(n), out(n);
+  for(size_t i = 0; i < n; i++)
+  {
+    data[i].x = (float)input[i].real();
+    data[i].y = (float)input[i].imag();
+  }
+  cl_int ciErr;
+  cl_mem cmData = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n, NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // upload and download included, as for the device engine
+  double best = -1.0;
+  for(int r = 0; r <= REGRESS_RUNS; r++)
+  {
+    double t = wallclock();
+    clEnqueueWriteBuffer(cqCommandQueue, cmData, CL_FALSE, 0, sizeof(cl_float2) * n, &data[0], 0, NULL, NULL);
+    conv.forward(cmData, n, 1, argc, argv);
+    ciErr = clEnqueueReadBuffer(cqCommandQueue, cmData, CL_TRUE, 0, sizeof(cl_float2) * n, &out[0], 0, NULL, NULL);
+    t = wallclock() - t;
+    if(ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    if(r > 0 && (best < 0.0 || t < best))
+      best = t;
+  }
+  clReleaseMemObject(cmData);
+
+  // the pass leaves the spectrum bit reversed
+  int lg = 0;
+  while(((size_t)1 << lg) < n)
+    lg++;
+  vector<Point> values(n);
+  for(size_t i = 0; i < n; i++)
+  {
+    size_t rev = 0;
+    for(int b = 0; b < lg; b++)
+      rev |= ((i >> b) & 1) << (lg - 1 - b);
+    values[i] = Point(out[rev].x, out[rev].y);
+  }
+  return measure("convolver", values, 1.0L, ref, best);
+}
+
+vector<RegressionResult> runRegression(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue,
+                                       const char *source, size_t source_length, unsigned int min_lg,
+                                       unsigned int max_lg, int argc, const char **argv)
+{
+  vector<RegressionResult> results;
+  Convolver conv(cxContext, cdDevice, cqCommandQueue, argc, argv);
+  for(unsigned int lg = min_lg; lg <= max_lg; lg++)
+  {
+    size_t n = (size_t)1 << lg;
+    // the same input on every run, so errors compare across builds
+    srand(lg);
+    vector<Point> input(n);
+    for(size_t i = 0; i < n; i++)
+      input[i] = Point(2.0 * rand() / RAND_MAX - 1.0, 2.0 * rand() / RAND_MAX - 1.0);
+    vector<Exact> ref = referenceTransform(input);
+
+    if(lg <= REGRESS_DIRECT_MAX_LG)
+      results.push_back(measure("reference", directTransform(input), 1.0L, ref, 0.0));
+    results.push_back(hostEngine<double>("host-dbl", input, ref));
+    results.push_back(hostEngine<float>("host-flt", input, ref));
+    results.push_back(deviceEngine(cxContext, cdDevice, source, source_length, input, ref, argc, argv));
+    results.push_back(convolverEngine(conv, cxContext, cqCommandQueue, input, ref, argc, argv));
+  }
+  return results;
+}
+
+// One line per result: engine n rms max_error mflops
+bool checkBaseline(const char *path, const vector<RegressionResult> &results)
+{
+  FILE* f = fopen(path, "r");
+  if(f == NULL)
+  {
+    shrLog("No baseline in %s, nothing to compare with\n", path);
+    return true;
+  }
+
+  vector<RegressionResult> baseline;
+  char line[256], engine[64];
+  RegressionResult entry;
+  unsigned long n;
+  while(fgets(line, sizeof(line), f) != NULL)
+  {
+    if(line[0] == '#')
+      continue;
+    if(sscanf(line, "%63s %lu %lf %lf %lf", engine, &n, &entry.rms, &entry.max_error, &entry.mflops) != 5)
+      continue;
+    entry.engine = engine;
+    entry.n = n;
+    baseline.push_back(entry);
+  }
+  fclose(f);
+
+  bool ok = true;
+  for(size_t i = 0; i < results.size(); i++)
+  {
+    const RegressionResult &r = results[i];
+    for(size_t j = 0; j < baseline.size(); j++)
+    {
+      const RegressionResult &b = baseline[j];
+      if(b.engine != r.engine || b.n != r.n)
+        continue;
+      // errors of exactly 0 (tiny sizes) get the float epsilon as their allowance
+      if(r.rms > REGRESS_ERROR_FACTOR * max(b.rms, 1.2e-7) || r.max_error > REGRESS_ERROR_FACTOR * max(b.max_error, 1.2e-7))
+      {
+        shrLog("REGRESSION %s %u: error rms %.3e max %.3e, baseline rms %.3e max %.3e\n", r.engine.c_str(),
+               (unsigned int)r.n, r.rms, r.max_error, b.rms, b.max_error);
+        ok = false;
+      }
+      if(b.mflops > 0.0 && r.mflops < REGRESS_SPEED_FACTOR * b.mflops)
+      {
+        shrLog("REGRESSION %s %u: %.1f MFlops, baseline %.1f\n", r.engine.c_str(), (unsigned int)r.n, r.mflops, b.mflops);
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+void storeBaseline(const char *path, const vector<RegressionResult> &results)
+{
+  FILE* f = fopen(path, "w");
+  if(f == NULL)
+  {
+    shrLog("Couldn't write baseline file %s\n", path);
+    return;
+  }
+  fprintf(f, "# engine n rms max_error mflops\n");
+  for(size_t i = 0; i < results.size(); i++)
+    fprintf(f, "%s %lu %.6e %.6e %.2f\n", results[i].engine.c_str(), (unsigned long)results[i].n,
+            results[i].rms, results[i].max_error, results[i].mflops);
+  fclose(f);
+}
@@ -0,0 +1,34 @@
+#ifndef _REGRESSION_H_
+#define _REGRESSION_H_
+
+#include <oclUtils.h>
+#include <string>
+#include <vector>
+
+/* Accuracy and speed of one engine at one size, against the long double reference. */
+struct RegressionResult
+{
+    std::string engine;
+    size_t n;
+    double rms;             /* relative RMS error, sqrt(sum |x - ref|^2 / sum |ref|^2) */
+    double max_error;       /* max |x - ref| over max |ref| */
+    double mflops;          /* 5 n log2 n per microsecond of the best of the timed runs */
+};
+
+/* Runs every engine (the host FFT in double and float, the device FFT2 path and the
+   Convolver pass) on random input of 2^min_lg..2^max_lg points and compares each with
+   a radix-2 transform in long double with directly evaluated twiddles. Up to 2^10 that
+   reference is itself checked against the O(n^2) DFT (engine "reference"). The device
+   programs are built from source with the float build options. */
+std::vector<RegressionResult> runRegression(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue,
+                                            const char *source, size_t source_length, unsigned int min_lg,
+                                            unsigned int max_lg, int argc, const char **argv);
+
+/* Compares results with the baseline file: an error that grew past REGRESS_ERROR_FACTOR
+   times its baseline or a throughput below REGRESS_SPEED_FACTOR of it is reported.
+   Returns false on any regression; entries missing from the file are not checked. */
+bool checkBaseline(const char *path, const std::vector<RegressionResult> &results);
+/* Writes results as the new baseline. */
+void storeBaseline(const char *path, const std::vector<RegressionResult> &results);
+
+#endif
@@ -3,22 +3,48 @@
 
 #include "oclFFT.h"
 #include "FFT.h"
+#include "Trace.h"
+#include "Tuner.h"
+#include "CodeletGen.h"
+#include "PlanCache.h"
+#include "NTT.h"
+#include "Convolver.h"
+#include "FFTND.h"
+#include "FFTService.h"
+#include "Regression.h"
+#include "Correlator.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <vector>
 
 #define PI 3.14159265
 #define EPSILON 0.000001
 #define EPSILON2 0.001
+#define MAX_DISCREPANCIES_SHOWN 10
 
 using namespace std;
 
-vector<double> multiply_polys(vector<double> poly_a, vector<double> poly_b, int argc, const char **argv);
+vector<double> multiply_polys(vector<double> poly_a, vector<double> poly_b, bool& matches_host, int argc, const char **argv);
 void opencl_init(int n, int argc, const char **argv);
-void compareValues(vector<FFT::Complex> cpu_transform_values, void * gpu_transform_values, int n);
+template <typename Complex2>
+void compareValues(vector<FFT<double>::Complex> cpu_transform_values, const Complex2 * gpu_transform_values, int n);
+template <typename T>
+void checkTransformGPU(const vector<FFT<double>::Complex>& input, const vector<FFT<double>::Complex>& expected,
+                       int n, int argc, const char **argv);
+bool checkNTT(int n, int argc, const char **argv);
+void checkFFTND(const vector<size_t>& dims, int argc, const char **argv);
+bool checkCorrelation(int count, int argc, const char **argv);
 
 const char* cSourceFile = "FFT2.cl";
+const char* cCommonSourceFile = "../common/FFT2.cl";    // where the source tree keeps it
+const char* cWisdomFile = "oclFFT.wisdom";
+const char* cBaselineFile = "oclFFT.baseline";
 
-void * cl_poly_a, * cl_poly_b, * cl_poly_c, * cl_debug;
+void * cl_poly_a, * cl_debug;
+bool use_double = false;
+size_t point_size = sizeof(cl_float2);
 cl_ulong local_memory_size;
 unsigned int points_per_group;
 unsigned int points_per_item;
@@ -30,8 +56,6 @@ cl_device_id cdDevice;
 cl_program cpProgram;
 cl_kernel ckKernel;
 cl_mem cmDevPolyMultA;
-cl_mem cmDevPolyMultB;
-cl_mem cmDevPolyMultC;
 cl_mem cmPointsPerGroup;
 cl_mem cmDevDebug;
 cl_mem cmDir;
@@ -39,6 +63,7 @@ size_t num_points;
 size_t items_per_group;
 size_t szGlobalWorkSize;
 size_t szLocalWorkSize;
+size_t l_mem_size;
 size_t szKernelLength;
 size_t log_size;
 cl_int ciErr1;
@@ -58,15 +83,207 @@ int main(int argc, const char **argv)
     poly_b.push_back(5);
     poly_b.push_back(-13);
     // -91x^3 - 4x^2 - 102x + 45
-    vector<double> result = multiply_polys(poly_a, poly_b, argc, argv);
-    bool success = abs(result[0] - 45) < EPSILON
-            && abs(result[1] + 102) < EPSILON
-            && abs(result[2] + 4) < EPSILON
-            && abs(result[3] + 91) < EPSILON;
+    bool matches_host = false;
+    vector<double> result = multiply_polys(poly_a, poly_b, matches_host, argc, argv);
+    // the device product is single precision
+    bool success = matches_host && result.size() == 4
+            && abs(result[0] - 45) < EPSILON2
+            && abs(result[1] + 102) < EPSILON2
+            && abs(result[2] + 4) < EPSILON2
+            && abs(result[3] + 91) < EPSILON2;
     cout << "Multiplying polynomials: " << (success ? "OK" : "FAILED") << endl;
+
+    // same product, exact, through the number-theoretic transform on the host and the device
+    vector<long long> int_a(poly_a.begin(), poly_a.end());
+    vector<long long> int_b(poly_b.begin(), poly_b.end());
+    NTT ntt(cxGPUContext, cdDevice, cqCommandQueue, argc, argv);
+    vector<long long> exact = NTT::multiply(int_a, int_b);
+    vector<long long> exact_gpu = ntt.multiplyGPU(int_a, int_b, argc, argv);
+    success = exact.size() == 4 && exact[0] == 45 && exact[1] == -102 && exact[2] == -4 && exact[3] == -91
+            && exact == exact_gpu;
+    cout << "Multiplying integer polynomials (NTT): " << (success ? "OK" : "FAILED") << endl;
+
+    int ntt_size = 0;
+    if(shrGetCmdLineArgumenti(argc, argv, "ntt-size", &ntt_size) && ntt_size > 0)
+    {
+      if(2 * (size_t)ntt_size - 1 > NTT_MAX_POINTS)
+      {
+        shrLog("Error: --ntt-size takes at most %u terms\n", NTT_MAX_POINTS / 2);
+        Cleanup(argc, (char **)argv, EXIT_FAILURE);
+      }
+      success = checkNTT(ntt_size, argc, argv);
+      cout << "NTT product of " << ntt_size << " term polynomials: " << (success ? "OK" : "FAILED") << endl;
+    }
+
+    if(shrCheckCmdLineFlag(argc, argv, "fftnd"))
+    {
+      vector<size_t> dims_2d, dims_3d;
+      dims_2d.push_back(256);
+      dims_2d.push_back(128);
+      dims_3d.push_back(32);
+      dims_3d.push_back(16);
+      dims_3d.push_back(64);
+      checkFFTND(dims_2d, argc, argv);
+      checkFFTND(dims_3d, argc, argv);
+    }
+
+    // many segments against one template, each holding it at a known fractional delay
+    int correlate_count = 0;
+    if(shrGetCmdLineArgumenti(argc, argv, "correlate", &correlate_count) && correlate_count > 0)
+    {
+      success = checkCorrelation(correlate_count, argc, argv);
+      cout << "Correlating " << correlate_count << " segments: " << (success ? "OK" : "FAILED") << endl;
+    }
+
+    // every engine against a long double reference up to 2^N points; error or throughput
+    // past the stored baseline fails the run, --update-baseline records a new one instead
+    int regress_lg = 0;
+    if(shrGetCmdLineArgumenti(argc, argv, "regress", &regress_lg) && regress_lg > 0)
+    {
+      char* cBaselinePath = (char *)cBaselineFile;
+      shrGetCmdLineArgumentstr(argc, argv, "baseline", &cBaselinePath);
+      vector<RegressionResult> results = runRegression(cxGPUContext, cdDevice, cqCommandQueue, cSourceCL, szKernelLength,
+                                                       3, regress_lg, argc, argv);
+      if(shrCheckCmdLineFlag(argc, argv, "update-baseline"))
+        storeBaseline(cBaselinePath, results);
+      else
+      {
+        success = checkBaseline(cBaselinePath, results);
+        cout << "Regression against " << cBaselinePath << ": " << (success ? "OK" : "FAILED") << endl;
+        if(!success)
+          return EXIT_FAILURE;
+      }
+    }
+
+    // stay up with OpenCL and the programs ready, batching socket requests into shared launches
+    char* cSocketPath = NULL;
+    if(shrGetCmdLineArgumentstr(argc, argv, "serve", &cSocketPath))
+    {
+      int window_us = 2000;
+      int max_batch = 64;
+      shrGetCmdLineArgumenti(argc, argv, "batch-window", &window_us);
+      shrGetCmdLineArgumenti(argc, argv, "max-batch", &max_batch);
+      Convolver conv(cxGPUContext, cdDevice, cqCommandQueue, argc, argv);
+      FFTService service(conv, cxGPUContext, cqCommandQueue, cSocketPath, window_us, max_batch, argc, argv);
+      service.run(argc, argv);
+    }
+}
+
+// A Gaussian pulse as the template and segments that hold it at random delays plus a
+// little noise; every delay has to come back to within a tenth of a sample.
+bool checkCorrelation(int count, int argc, const char **argv)
+{
+  const size_t template_points = 64, segment_points = 1024;
+  vector<float> pulse(template_points);
+  for(size_t i = 0; i < template_points; i++)
+    pulse[i] = (float)exp(-(i - 32.0) * (i - 32.0) / 32.0);
+
+  vector<float> segments(count * segment_points);
+  vector<double> delays(count);
+  for(int s = 0; s < count; s++)
+  {
+    delays[s] = rand() % (segment_points - template_points) + (double)rand() / RAND_MAX;
+    for(size_t i = 0; i < segment_points; i++)
+    {
+      double t = i - delays[s] - 32.0;
+      segments[s * segment_points + i] = (float)(exp(-t * t / 32.0) + 0.01 * ((double)rand() / RAND_MAX - 0.5));
+    }
+  }
+
+  Convolver conv(cxGPUContext, cdDevice, cqCommandQueue, argc, argv);
+  Correlator correlator(conv, cxGPUContext, cdDevice, cqCommandQueue, pulse, segment_points, 256, argc, argv);
+  vector<CorrelationPeak> peaks;
+  correlator.correlate(&segments[0], count, peaks, argc, argv);
+
+  double worst = 0.0;
+  for(int s = 0; s < count; s++)
+    worst = max(worst, abs(peaks[s].lag - delays[s]));
+  cout << "Largest delay error: " << worst << " samples" << endl;
+  return worst < 0.1;
+}
+
+// Random data through the host and the device multidimensional FFT, forward and back.
+void checkFFTND(const vector<size_t>& dims, int argc, const char **argv)
+{
+  size_t total = FFTND::points(dims);
+  vector<cl_float2> data(total), host(total), device(total);
+  for(size_t i = 0; i < total; i++)
+  {
+    data[i].x = (float)rand() / RAND_MAX - 0.5f;
+    data[i].y = (float)rand() / RAND_MAX - 0.5f;
+  }
+
+  cl_mem cmData = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_float2) * total, &data[0], &ciErr1);
+  if (ciErr1 != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  Convolver conv(cxGPUContext, cdDevice, cqCommandQueue, argc, argv);
+  FFTND fft(cxGPUContext, cdDevice, cqCommandQueue, conv, argc, argv);
+
+  host = data;
+  shrDeltaT(0);
+  FFTND::transform(host, dims, 1);
+  double cpu_time = shrDeltaT(0);
+  fft.transformGPU(cmData, dims, 1, argc, argv);
+  clFinish(cqCommandQueue);
+  double gpu_time = shrDeltaT(0);
+  clEnqueueReadBuffer(cqCommandQueue, cmData, CL_TRUE, 0, sizeof(cl_float2) * total, &device[0], 0, NULL, NULL);
+  shrLog("FFTND %u points: host %.3f ms, device %.3f ms\n", (unsigned int)total, cpu_time * 1000, gpu_time * 1000);
+
+  vector<FFT<double>::Complex> host_values(total);
+  for(size_t i = 0; i < total; i++)
+    host_values[i] = FFT<double>::Complex(host[i].x, host[i].y);
+  compareValues(host_values, &device[0], total);
+
+  // the inverse of the forward transform is the input again
+  fft.transformGPU(cmData, dims, -1, argc, argv);
+  clEnqueueReadBuffer(cqCommandQueue, cmData, CL_TRUE, 0, sizeof(cl_float2) * total, &device[0], 0, NULL, NULL);
+  for(size_t i = 0; i < total; i++)
+    host_values[i] = FFT<double>::Complex(data[i].x, data[i].y);
+  compareValues(host_values, &device[0], total);
+  clReleaseMemObject(cmData);
 }
 
-vector<double> multiply_polys(vector<double> poly_a, vector<double> poly_b, int argc, const char **argv)
+// Random polynomials with 20 bit coefficients, compared between host and device
+// and spot checked against direct sums.
+bool checkNTT(int n, int argc, const char **argv)
+{
+  vector<long long> a(n), b(n);
+  for(int i = 0; i < n; i++)
+  {
+    a[i] = (rand() % (1 << 21)) - (1 << 20);
+    b[i] = (rand() % (1 << 21)) - (1 << 20);
+  }
+
+  NTT ntt(cxGPUContext, cdDevice, cqCommandQueue, argc, argv);
+  shrDeltaT(0);
+  vector<long long> c = NTT::multiply(a, b);
+  double cpu_time = shrDeltaT(0);
+  vector<long long> c_gpu = ntt.multiplyGPU(a, b, argc, argv);
+  double gpu_time = shrDeltaT(0);
+  shrLog("NTT: host %.3f s, device %.3f s\n", cpu_time, gpu_time);
+
+  bool OK = (c == c_gpu);
+  for(int probe = 0; probe < 16; probe++)
+  {
+    int k = (probe == 0) ? n - 1 : rand() % (2 * n - 1);
+    long long sum = 0;
+    for(int i = max(0, k - n + 1); i <= min(k, n - 1); i++)
+      sum += a[i] * b[k - i];
+    if(sum != c[k])
+    {
+      OK = false;
+      cout << "Discrepancy at (" << k << ") " << sum << " " << c[k] << endl;
+    }
+  }
+  return OK;
+}
+
+// The product through the device-resident convolution, checked against the host FFT;
+// matches_host is false when the two disagree.
+vector<double> multiply_polys(vector<double> poly_a, vector<double> poly_b, bool& matches_host, int argc, const char **argv)
 {
     // 1. Make place for resulting polynomial and ensure n is a power of two.
     int n = poly_a.size() + poly_b.size();
@@ -75,25 +292,26 @@ vector<double> multiply_polys(vector<double> poly_a, vector<double> poly_b, int
         power_of_2 <<= 1;
     n = power_of_2;
     opencl_init(n, argc, argv); // init GPU stuff
+    vector<double> coeffs_a(poly_a), coeffs_b(poly_b);
     poly_a.resize(n, 0);
     poly_b.resize(n, 0);
     // 2. Compute point-value representation of a and b for values of unity
     // roots using DFT.
-    vector<FFT::Complex> poly_a_complex(n);
-    vector<FFT::Complex> poly_b_complex(n);
+    vector<FFT<double>::Complex> poly_a_complex(n);
+    vector<FFT<double>::Complex> poly_b_complex(n);
 
     for (int i = 0; i < n; ++i)
     {
         poly_a_complex[i] = poly_a[i];
         poly_b_complex[i] = poly_b[i];
     }
-    FFT dft(n);
+    FFT<double> dft(n);
 
-    vector<FFT::Complex> poly_a_values = dft.transform(poly_a_complex);
+    vector<FFT<double>::Complex> poly_a_values = dft.transform(poly_a_complex);
 
     // Set the Argument values
     ciErr1 = clSetKernelArg(ckKernel, 0, sizeof(cl_mem), (void*)&cmDevPolyMultA);
-    ciErr1 |= clSetKernelArg(ckKernel, 1, sizeof(cl_float2) * n, NULL);
+    ciErr1 |= clSetKernelArg(ckKernel, 1, l_mem_size, NULL);
     ciErr1 |= clSetKernelArg(ckKernel, 2, sizeof(cl_mem), (void*)&cmPointsPerGroup);
     ciErr1 |= clSetKernelArg(ckKernel, 3, sizeof(cl_mem), (void*)&cmDevDebug);
     ciErr1 |= clSetKernelArg(ckKernel, 4, sizeof(cl_mem), (void*)&cmDir);
@@ -104,29 +322,12 @@ vector<double> multiply_polys(vector<double> poly_a, vector<double> poly_b, int
       Cleanup(argc, (char **)argv, EXIT_FAILURE);
     }
 
-    dft.transformGPU(poly_a_complex, cl_poly_a, cl_debug, cmDevPolyMultA, 
-                     cmPointsPerGroup, cmDevDebug, cmDir, ckKernel, szGlobalWorkSize, szLocalWorkSize, points_per_group,
-                     cqCommandQueue, ciErr1, argc, (const char **)argv);
-    compareValues(poly_a_values, cl_poly_a, n);
-
-    vector<FFT::Complex> poly_b_values = dft.transform(poly_b_complex);
-    // Set the Argument values
-    ciErr1 = clSetKernelArg(ckKernel, 0, sizeof(cl_mem), (void*)&cmDevPolyMultB);
-    ciErr1 |= clSetKernelArg(ckKernel, 1, sizeof(cl_float2) * n, NULL);
-    ciErr1 |= clSetKernelArg(ckKernel, 2, sizeof(cl_mem), (void*)&cmPointsPerGroup);
-    ciErr1 |= clSetKernelArg(ckKernel, 3, sizeof(cl_mem), (void*)&cmDevDebug);
-    ciErr1 |= clSetKernelArg(ckKernel, 4, sizeof(cl_mem), (void*)&cmDir);
-    shrLog("clSetKernelArg 0...1\n\n");
-    if (ciErr1 != CL_SUCCESS)
-    {   
-      shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
-      Cleanup(argc, (char **)argv, EXIT_FAILURE);
-    }
+    if(use_double)
+      checkTransformGPU<double>(poly_a_complex, poly_a_values, n, argc, argv);
+    else
+      checkTransformGPU<float>(poly_a_complex, poly_a_values, n, argc, argv);
 
-    dft.transformGPU(poly_b_complex, cl_poly_b, cl_debug, cmDevPolyMultB, 
-                     cmPointsPerGroup, cmDevDebug, cmDir, ckKernel, szGlobalWorkSize, szLocalWorkSize, points_per_group,
-                     cqCommandQueue, ciErr1, argc, (const char **)argv);
-    compareValues(poly_b_values, cl_poly_b, n);
+    vector<FFT<double>::Complex> poly_b_values = dft.transform(poly_b_complex);
 
     for (int i = 0; i < n; ++i)
     {
@@ -134,35 +335,37 @@ vector<double> multiply_polys(vector<double> poly_a, vector<double> poly_b, int
         poly_b_values[i] *= n;
     }
     // 3. Multiply poly a values by poly b values.
-    vector<FFT::Complex> poly_c_values(n);
+    vector<FFT<double>::Complex> poly_c_values(n);
     for (int i = 0; i < n; ++i)
         poly_c_values[i] = poly_a_values[i] * poly_b_values[i];
     // 4. Compute coefficients representation of c using Inverse DFT.
-    FFT idft(n, true);
-    vector<FFT::Complex> poly_c_complex = idft.transform(poly_c_values);
-
-    // Set the Argument values
-    ciErr1 = clSetKernelArg(ckKernel, 0, sizeof(cl_mem), (void*)&cmDevPolyMultC);
-    ciErr1 |= clSetKernelArg(ckKernel, 1, sizeof(cl_float2) * n, NULL);
-    ciErr1 |= clSetKernelArg(ckKernel, 2, sizeof(cl_mem), (void*)&cmPointsPerGroup);
-    ciErr1 |= clSetKernelArg(ckKernel, 3, sizeof(cl_mem), (void*)&cmDevDebug);
-    ciErr1 |= clSetKernelArg(ckKernel, 4, sizeof(cl_mem), (void*)&cmDir);
-    shrLog("clSetKernelArg 0...2\n\n");
-    if (ciErr1 != CL_SUCCESS)
-    {   
-      shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
-      Cleanup(argc, (char **)argv, EXIT_FAILURE);
-    }
+    FFT<double> idft(n, true);
+    vector<FFT<double>::Complex> poly_c_complex = idft.transform(poly_c_values);
 
-    idft.transformGPU(poly_c_values, cl_poly_c, cl_debug, cmDevPolyMultC, 
-                      cmPointsPerGroup, cmDevDebug, cmDir, ckKernel, szGlobalWorkSize, szLocalWorkSize, points_per_group,
-                      cqCommandQueue, ciErr1, argc, (const char **)argv);
-    compareValues(poly_c_complex, cl_poly_c, n);
+    // 5. The product itself on the device: both spectra stay in device memory, only the
+    // operands go up and only the coefficients come back.
+    Convolver conv(cxGPUContext, cdDevice, cqCommandQueue, argc, argv);
+    vector<double> poly_c_gpu = conv.convolve(coeffs_a, coeffs_b, argc, argv);
 
     vector<double> poly_c(n);
     for (int i = 0; i < n; ++i)
         poly_c[i] = poly_c_complex[i].real() / n;
-    return poly_c;
+
+    int OK = 1;
+    for (size_t i = 0; i < poly_c_gpu.size(); ++i)
+    {
+      if(abs(poly_c_gpu[i] - poly_c[i]) > EPSILON2 * max(1.0, abs(poly_c[i])))
+      {
+        OK = 0;
+        cout << "Discrepancy at (" << i << ") " << poly_c[i] << " " << poly_c_gpu[i] << endl;
+      }
+    }
+    if(OK)
+    {
+      cout << "OK!" << endl;
+    }
+    matches_host = (OK != 0);
+    return poly_c_gpu;
 }
 
 void opencl_init(int n, int argc, const char **argv)
@@ -174,24 +377,15 @@ void opencl_init(int n, int argc, const char **argv)
     shrLog("%s Starting...\n\n# of elements per Array \t= %i\n", argv[0], n);
     
     shrLog("Initializing data...\n");
-    cl_poly_a = (void *)malloc(sizeof(cl_float2) * n);
-    cl_poly_b = (void *)malloc(sizeof(cl_float2) * n);
-    cl_poly_c = (void *)malloc(sizeof(cl_float2) * n);
+    // room for either precision, the device is picked below
+    cl_poly_a = (void *)malloc(sizeof(cl_double2) * n);
 
-    cl_debug = (void *)malloc(sizeof(cl_float2) * n);
+#if FFT_TRACE_LEVEL >= FFT_TRACE_DEBUG
+    cl_debug = (void *)malloc(sizeof(cl_double2) * n);
+#endif
 
-    //Get an OpenCL platform
-    ciErr1 = clGetPlatformIDs(1, &cpPlatform, NULL);
-    
-    shrLog("clGetPlatformID...\n"); 
-    if (ciErr1 != CL_SUCCESS)
-    {   
-      shrLog("Error in clGetPlatformID, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
-      Cleanup(argc, (char **)argv, EXIT_FAILURE);
-    }   
-
-    //Get the devices
-    ciErr1 = clGetDeviceIDs(cpPlatform, CL_DEVICE_TYPE_GPU, 1, &cdDevice, NULL);
+    //Get a device: the first GPU on any platform, any other device type when there's none
+    ciErr1 = defaultDevice(&cpPlatform, &cdDevice);
     shrLog("clGetDeviceIDs...\n"); 
     if (ciErr1 != CL_SUCCESS)
     {   
@@ -217,26 +411,18 @@ void opencl_init(int n, int argc, const char **argv)
       Cleanup(argc, (char **)argv, EXIT_FAILURE);
     }   
 
-    // Allocate the OpenCL buffer memory objects for source and result on the device GMEM
-    cmDevPolyMultA = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n, NULL, &ciErr1);
-
-    shrLog("clCreateBuffer...\n");
-    if (ciErr1 != CL_SUCCESS)
-    {
-        shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
-        Cleanup(argc, (char **)argv, EXIT_FAILURE);
-    } 
-
-    cmDevPolyMultB = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n, NULL, &ciErr1);
-
-    shrLog("clCreateBuffer...\n");
-    if (ciErr1 != CL_SUCCESS)
+    // Device precision: double when asked for and the device has cl_khr_fp64, float otherwise
+    if(shrCheckCmdLineFlag(argc, argv, "double"))
     {
-        shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
-        Cleanup(argc, (char **)argv, EXIT_FAILURE);
-    } 
+      use_double = FFTPrecision<double>::supported(cdDevice);
+      if(!use_double)
+        shrLog("Device has no cl_khr_fp64, the device transform stays in float\n");
+    }
+    point_size = use_double ? sizeof(FFT<double>::Complex2) : sizeof(FFT<float>::Complex2);
+    shrLog("Device precision: %s\n", use_double ? "double" : "float");
 
-    cmDevPolyMultC = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n, NULL, &ciErr1);
+    // Allocate the OpenCL buffer memory objects for source and result on the device GMEM
+    cmDevPolyMultA = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, point_size * n, NULL, &ciErr1);
 
     shrLog("clCreateBuffer...\n");
     if (ciErr1 != CL_SUCCESS)
@@ -255,7 +441,9 @@ void opencl_init(int n, int argc, const char **argv)
     } 
 
 
-    cmDevDebug = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n, NULL, &ciErr1);
+    // the debug buffer only exists when the kernels are built to fill it
+#if FFT_TRACE_LEVEL >= FFT_TRACE_DEBUG
+    cmDevDebug = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, point_size * n, NULL, &ciErr1);
 
     shrLog("clCreateBuffer...\n");
     if (ciErr1 != CL_SUCCESS)
@@ -263,6 +451,7 @@ void opencl_init(int n, int argc, const char **argv)
         shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
         Cleanup(argc, (char **)argv, EXIT_FAILURE);
     } 
+#endif
 
     cmDir = clCreateBuffer(cxGPUContext, CL_MEM_READ_WRITE, sizeof(cl_int), NULL, &ciErr1);
 
@@ -277,16 +466,17 @@ void opencl_init(int n, int argc, const char **argv)
      // Read the OpenCL kernel in from source file
     shrLog("oclLoadProgSource (%s)...\n", cSourceFile);
     cPathAndName = shrFindFilePath(cSourceFile, argv[0]);
+    if(cPathAndName == NULL)
+      cPathAndName = shrFindFilePath(cCommonSourceFile, argv[0]);
     cSourceCL = oclLoadProgSource(cPathAndName, "", &szKernelLength);
     
-    // Create the program
-    cpProgram = clCreateProgramWithSource(cxGPUContext, 1, (const char **)&cSourceCL, &szKernelLength, &ciErr1);
-    shrLog("clCreateProgramWithSource...\n");
-    if (ciErr1 != CL_SUCCESS)
-    {
-      shrLog("Error in clCreateProgramWithSource, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
-      Cleanup(argc, (char **)argv, EXIT_FAILURE);
-    }
+    // Create the program; from CODELET_MIN_POINTS up a straight-line codelet is built into it, and
+    // with --binary-cache=dir the build comes from (and goes to) a stored program binary.
+    // Here the codelet can only run as the whole transform, one group of all n points.
+    bool use_codelet = codeletPoints(num_points) == (unsigned int)num_points;
+    char* cBinaryCache = NULL;
+    shrGetCmdLineArgumentstr(argc, argv, "binary-cache", &cBinaryCache);
+    string binary_name;
   
     // Build the program with 'mad' Optimization option
     #ifdef MAC
@@ -294,21 +484,9 @@ void opencl_init(int n, int argc, const char **argv)
     #else
       char* flags = "-cl-fast-relaxed-math";
     #endif
-    ciErr1 = clBuildProgram(cpProgram, 0, NULL, NULL, NULL, NULL);
-    shrLog("clBuildProgram...\n");
-    if (ciErr1 != CL_SUCCESS)
-    {
-      clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, 
-      	0, NULL, &log_size);
-      program_log = (char *)malloc(log_size + 1);
-      program_log[log_size] = '\0';
-      clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG,
-      		log_size + 1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
-      shrLog("Error in clBuildProgram, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
-      Cleanup(argc, (char **)argv, EXIT_FAILURE);
-    }
+    const char* precision_flags = use_double ? FFTPrecision<double>::buildOptions() : FFTPrecision<float>::buildOptions();
+    cpProgram = buildFFTProgram(cxGPUContext, cdDevice, cSourceCL, szKernelLength, num_points, precision_flags,
+                                cBinaryCache, binary_name, argc, argv);
     // Create the kernel
     ckKernel = clCreateKernel(cpProgram, "FFT2", &ciErr1);
     shrLog("clCreateKernel FFT2...\n");
@@ -326,32 +504,104 @@ void opencl_init(int n, int argc, const char **argv)
       Cleanup(argc, (char **)argv, EXIT_FAILURE);
     }
 
-    points_per_group = local_memory_size/(2*sizeof(float));
-    points_per_item = points_per_group/items_per_group;
+    // Launch configuration: stored wisdom first, then a tuning run if asked for (the
+    // codelet among its candidates), otherwise the codelet or the configuration derived
+    // from the device limits. transformGPU has no host tail here, so one group must
+    // cover all n points.
+    LaunchConfig config;
+    char* cWisdomPath = (char *)cWisdomFile;
+    shrGetCmdLineArgumentstr(argc, argv, "wisdom", &cWisdomPath);
+    string device_key = deviceKey(cdDevice);
+    // wisdom and tuning are per precision, point_size tells them which this program is
+    if(!loadWisdom(cWisdomPath, device_key, num_points, point_size, config) || config.points_per_group < num_points)
+    {
+      if(shrCheckCmdLineFlag(argc, argv, "tune"))
+      {
+        config = tuneLaunchConfig(cxGPUContext, cdDevice, cpProgram, "FFT2", num_points, num_points, point_size, argc, argv);
+        storeWisdom(cWisdomPath, device_key, num_points, point_size, config, binary_name);
+      }
+      else if(use_codelet)
+      {
+        config = codeletLaunchConfig(num_points);
+      }
+      else
+      {
+        config = defaultLaunchConfig(num_points, items_per_group, local_memory_size, 8, point_size);
+      }
+    }
+    if(config.points_per_group < num_points)
+    {
+      shrLog("%u points don't fit in the local memory of one work-group\n", (unsigned int)num_points);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    points_per_group = config.points_per_group;
+    points_per_item = config.points_per_item;
+    szLocalWorkSize = config.szLocalWorkSize;
+    szGlobalWorkSize = config.szGlobalWorkSize;
+    l_mem_size = config.local_mem_size;
+    shrLog("Launch configuration: points per group %u, points per item %u, radix %u, local %u, global %u\n",
+           points_per_group, points_per_item, config.radix, (unsigned int)szLocalWorkSize, (unsigned int)szGlobalWorkSize);
+
+    // the in-group kernel follows the configuration's radix (FFT2_R8 for radix 8, the codelet above it)
+    if(config.radix != 2)
+    {
+      clReleaseKernel(ckKernel);
+      ckKernel = clCreateKernel(cpProgram, groupKernelName(config.radix).c_str(), &ciErr1);
+      if (ciErr1 != CL_SUCCESS)
+      {
+        shrLog("Error in clCreateKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+        Cleanup(argc, (char **)argv, EXIT_FAILURE);
+      }
+    }
 
-    szLocalWorkSize = num_points/points_per_item;
-    szGlobalWorkSize = num_points/points_per_item;
-    points_per_group = num_points;
+    // ahead-of-time plans for a list of sizes: programs into the binary cache, configurations into wisdom
+    char* cPlanSizes = NULL;
+    if(shrGetCmdLineArgumentstr(argc, argv, "plan-sizes", &cPlanSizes))
+      generatePlans(cxGPUContext, cdDevice, cSourceCL, szKernelLength, precision_flags, point_size,
+                    parseSizes(cPlanSizes), 0, cWisdomPath, cBinaryCache, shrCheckCmdLineFlag(argc, argv, "tune"),
+                    argc, argv);
 }
 
-void compareValues(vector<FFT::Complex> cpu_transform_values, void * gpu_transform_values, int n)
+// The device transform of input in precision T, checked against the double precision host values.
+template <typename T>
+void checkTransformGPU(const vector<FFT<double>::Complex>& input, const vector<FFT<double>::Complex>& expected,
+                       int n, int argc, const char **argv)
 {
-  cl_float2 * gpu_transform_values_fl = (cl_float2 *)gpu_transform_values;
-  int OK = 1;
+  vector<typename FFT<T>::Complex> device_input(n);
+  for(int i = 0; i < n; ++i)
+    device_input[i] = typename FFT<T>::Complex((T)input[i].real(), (T)input[i].imag());
+
+  FFT<T> dft(n);
+  dft.transformGPU(device_input, cl_poly_a, cl_debug, cmDevPolyMultA,
+                   cmPointsPerGroup, cmDevDebug, cmDir, ckKernel, szGlobalWorkSize, szLocalWorkSize, points_per_group,
+                   cqCommandQueue, ciErr1, argc, argv);
+  compareValues(expected, (const typename FFT<T>::Complex2 *)cl_poly_a, n);
+}
+
+template <typename Complex2>
+void compareValues(vector<FFT<double>::Complex> cpu_transform_values, const Complex2 * gpu_transform_values_fl, int n)
+{
+  int discrepancies = 0;
   for(int i = 0; i < n; i++)
   {
     if((abs(real(cpu_transform_values[i]) - gpu_transform_values_fl[i].x) > EPSILON2) ||
        (abs(imag(cpu_transform_values[i]) - gpu_transform_values_fl[i].y) > EPSILON2))
     {
-      OK = 0;
-      cout << "Discrepancy at (" << i << ") " << real(cpu_transform_values[i]) << " " << gpu_transform_values_fl[i].x << " "
-                                              << imag(cpu_transform_values[i]) << " " << gpu_transform_values_fl[i].y << endl;
+      // the first few say where; the count says how bad
+      if(discrepancies++ < MAX_DISCREPANCIES_SHOWN)
+        cout << "Discrepancy at (" << i << ") " << real(cpu_transform_values[i]) << " " << gpu_transform_values_fl[i].x << " "
+                                                << imag(cpu_transform_values[i]) << " " << gpu_transform_values_fl[i].y << endl;
     }
   }
-  if(OK)
+  if(discrepancies == 0)
   {
     cout << "OK!" << endl;
   }
+  else
+  {
+    cout << discrepancies << " of " << n << " points differ by more than " << EPSILON2 << endl;
+  }
 }
 
 void Cleanup (int argc, char **argv, int iExitCode)
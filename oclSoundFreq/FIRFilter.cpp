@@ -0,0 +1,146 @@
+#include "FIRFilter.h"
+#include "Convolver.h"
+#include "oclFFT.h"
+#include <cassert>
+
+using namespace std;
+
+FIRFilter::FIRFilter(Convolver& convolver, cl_context cxContext, cl_command_queue cqCommandQueue,
+                     const vector<float>& taps, Method method, size_t fft_size, size_t batch,
+                     int argc, const char **argv)
+    : convolver(convolver), cqCommandQueue(cqCommandQueue), method(method), taps(taps.size()),
+      batch(batch > 0 ? batch : 1)
+{
+  assert(this->taps > 0);
+  n = fft_size ? fft_size : max((size_t)1024, Convolver::transformSize(4 * this->taps));
+  assert(n > this->taps && Convolver::transformSize(n) == n);
+  hop = n - this->taps + 1;
+
+  cl_int ciErr;
+  cmFilter = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n, NULL, &ciErr);
+  cmBlocks = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n * this->batch, NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // the filter spectrum never leaves the device, every block is multiplied by it there
+  staging.resize(n * this->batch);
+  for(size_t i = 0; i < n; i++)
+  {
+    staging[i].x = (i < this->taps) ? taps[i] : 0.0f;
+    staging[i].y = 0.0f;
+  }
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmFilter, CL_TRUE, 0, sizeof(cl_float2) * n, &staging[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  convolver.forward(cmFilter, n, 1, argc, argv, 1, this->taps);
+
+  reset();
+}
+
+FIRFilter::~FIRFilter()
+{
+  if(cmBlocks)clReleaseMemObject(cmBlocks);
+  if(cmFilter)clReleaseMemObject(cmFilter);
+}
+
+void FIRFilter::reset()
+{
+  // overlap-save windows start taps-1 samples before the block; the stream starts in silence
+  pending.assign(method == OVERLAP_SAVE ? taps - 1 : 0, 0.0f);
+  tail.assign(taps - 1, 0.0f);
+}
+
+size_t FIRFilter::process(const float *in, size_t count, vector<float>& out, int argc, const char **argv)
+{
+  size_t before = out.size();
+  size_t history = (method == OVERLAP_SAVE) ? taps - 1 : 0;
+  pending.insert(pending.end(), in, in + count);
+
+  size_t blocks = (pending.size() - history) / hop;
+  while(blocks > 0)
+  {
+    size_t rows = min(blocks, batch);
+    runBlocks(rows, out, argc, argv);
+    blocks -= rows;
+  }
+  return out.size() - before;
+}
+
+size_t FIRFilter::flush(vector<float>& out, int argc, const char **argv)
+{
+  size_t before = out.size();
+  size_t history = (method == OVERLAP_SAVE) ? taps - 1 : 0;
+
+  // the remaining input plus the filter's ring-out, padded with silence to whole blocks
+  size_t owed = pending.size() - history + taps - 1;
+  size_t blocks = (owed + hop - 1) / hop;
+  pending.resize(history + blocks * hop, 0.0f);
+  while(blocks > 0)
+  {
+    size_t rows = min(blocks, batch);
+    runBlocks(rows, out, argc, argv);
+    blocks -= rows;
+  }
+  out.resize(before + owed);
+
+  reset();
+  return owed;
+}
+
+// Filters the first rows blocks of pending and drops them from it.
+void FIRFilter::runBlocks(size_t rows, vector<float>& out, int argc, const char **argv)
+{
+  size_t window = (method == OVERLAP_SAVE) ? n : hop;
+  for(size_t r = 0; r < rows; r++)
+  {
+    const float *src = &pending[r * hop];
+    cl_float2 *row = &staging[r * n];
+    for(size_t i = 0; i < n; i++)
+    {
+      row[i].x = (i < window) ? src[i] : 0.0f;
+      row[i].y = 0.0f;
+    }
+  }
+
+  cl_int ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmBlocks, CL_FALSE, 0, sizeof(cl_float2) * n * rows, &staging[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  // overlap-add blocks are zero past hop; overlap-save reads whole windows
+  convolver.forward(cmBlocks, n, rows, argc, argv, 1, window);
+  convolver.multiply(cmBlocks, cmFilter, n * rows, 0, n, 1.0f / n, argc, argv);
+  convolver.inverse(cmBlocks, n, rows, argc, argv);
+  ciErr = clEnqueueReadBuffer(cqCommandQueue, cmBlocks, CL_TRUE, 0, sizeof(cl_float2) * n * rows, &staging[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  for(size_t r = 0; r < rows; r++)
+  {
+    const cl_float2 *row = &staging[r * n];
+    if(method == OVERLAP_SAVE)
+    {
+      // the first taps-1 points are wrapped around, the rest is the linear result
+      for(size_t i = taps - 1; i < n; i++)
+        out.push_back(row[i].x);
+    }
+    else
+    {
+      for(size_t i = 0; i < hop; i++)
+        out.push_back(row[i].x + (i < taps - 1 ? tail[i] : 0.0f));
+      for(size_t i = 0; i < taps - 1; i++)
+        tail[i] = row[hop + i].x + (hop + i < taps - 1 ? tail[hop + i] : 0.0f);
+    }
+  }
+  pending.erase(pending.begin(), pending.begin() + rows * hop);
+}
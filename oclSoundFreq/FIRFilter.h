@@ -0,0 +1,54 @@
+#ifndef _FIRFILTER_H_
+#define _FIRFILTER_H_
+
+#include <oclUtils.h>
+#include <vector>
+
+class Convolver;
+
+/* Streaming FIR filter for long impulse responses. The input is cut into
+   fixed blocks that go through the device in batches of FFTs against a filter
+   spectrum computed once at construction and kept in device memory.
+   Overlap-add zero pads each block and carries the M-1 sample tail forward;
+   overlap-save feeds overlapping windows and keeps only the valid part. */
+class FIRFilter
+{
+    public:
+        enum Method { OVERLAP_ADD, OVERLAP_SAVE };
+
+        /* fft_size = 0 picks a power of 2 about four times the number of taps,
+           batch is the number of blocks sent to the device at once. */
+        FIRFilter(Convolver& convolver, cl_context cxContext, cl_command_queue cqCommandQueue,
+                  const std::vector<float>& taps, Method method, size_t fft_size, size_t batch,
+                  int argc, const char **argv);
+        ~FIRFilter();
+
+        /* Feeds count samples of the stream and appends every output sample that is
+           complete to out. Returns the number of samples appended. */
+        size_t process(const float *in, size_t count, std::vector<float>& out, int argc, const char **argv);
+        /* Ends the stream: appends the outstanding samples, including the M-1 sample
+           tail of the filter, and resets the filter for a new stream. */
+        size_t flush(std::vector<float>& out, int argc, const char **argv);
+
+        size_t fftSize() const { return n; }
+        size_t blockSize() const { return hop; }
+
+    private:
+        Convolver& convolver;
+        cl_command_queue cqCommandQueue;
+        cl_mem cmFilter;            /* filter spectrum, bit reversed, computed once */
+        cl_mem cmBlocks;            /* batch rows of n points */
+        Method method;
+        size_t taps;
+        size_t n;
+        size_t hop;                 /* new input samples per block, n - taps + 1 */
+        size_t batch;
+        std::vector<float> pending; /* input not yet filtered (overlap-save: prefixed with taps-1 samples of history) */
+        std::vector<float> tail;    /* overlap-add carry of the previous block */
+        std::vector<cl_float2> staging;
+
+        void reset();
+        void runBlocks(size_t rows, std::vector<float>& out, int argc, const char **argv);
+};
+
+#endif
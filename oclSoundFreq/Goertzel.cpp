@@ -0,0 +1,155 @@
+#include "Goertzel.h"
+#include "CpuEngine.h"
+#include <cmath>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// bins run through the recurrence together, in two SSE2 registers of two doubles
+#define GOERTZEL_LANES 4
+// flops per sample and bin of the recurrence, against 5 per point and stage of a radix-2 FFT
+#define GOERTZEL_FLOPS 4
+#define FFT_FLOPS 5
+
+using namespace std;
+
+struct GoertzelJob
+{
+    const float *samples;
+    size_t n;
+    size_t chunks;
+    size_t groups;              // GOERTZEL_LANES bins each
+    const double *coeffs;
+    const double *cosines;
+    const double *sines;
+    const size_t *bins;         // padded like the coefficients
+    double *partials;           // per chunk, interleaved re, im for every padded bin
+};
+
+// s = x + 2cos(w) s1 - s2 over samples[begin, end) for the GOERTZEL_LANES bins starting at lane
+static void recurrence(const GoertzelJob *job, size_t begin, size_t end, size_t lane, double *s1, double *s2)
+{
+  const float *x = job->samples;
+  const double *c = job->coeffs + lane;
+  size_t i = begin;
+#ifdef __SSE2__
+  __m128d c0 = _mm_loadu_pd(c), c1 = _mm_loadu_pd(c + 2);
+  __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+  __m128d b0 = _mm_setzero_pd(), b1 = _mm_setzero_pd();
+  for(; i < end; i++)
+  {
+    __m128d v = _mm_set1_pd(x[i]);
+    __m128d t0 = _mm_sub_pd(_mm_add_pd(v, _mm_mul_pd(c0, a0)), b0);
+    __m128d t1 = _mm_sub_pd(_mm_add_pd(v, _mm_mul_pd(c1, a1)), b1);
+    b0 = a0; b1 = a1;
+    a0 = t0; a1 = t1;
+  }
+  _mm_storeu_pd(s1, a0); _mm_storeu_pd(s1 + 2, a1);
+  _mm_storeu_pd(s2, b0); _mm_storeu_pd(s2 + 2, b1);
+#else
+  for(int l = 0; l < GOERTZEL_LANES; l++)
+    s1[l] = s2[l] = 0.0;
+  for(; i < end; i++)
+  {
+    for(int l = 0; l < GOERTZEL_LANES; l++)
+    {
+      double t = x[i] + c[l] * s1[l] - s2[l];
+      s2[l] = s1[l];
+      s1[l] = t;
+    }
+  }
+#endif
+}
+
+static void runChunks(void *arg, size_t first, size_t last)
+{
+  GoertzelJob *job = (GoertzelJob *)arg;
+  size_t padded = job->groups * GOERTZEL_LANES;
+  double s1[GOERTZEL_LANES], s2[GOERTZEL_LANES];
+  for(size_t chunk = first; chunk < last; chunk++)
+  {
+    size_t begin = job->n * chunk / job->chunks;
+    size_t end = job->n * (chunk + 1) / job->chunks;
+    double *out = job->partials + 2 * chunk * padded;
+    for(size_t g = 0; g < job->groups; g++)
+    {
+      size_t lane = g * GOERTZEL_LANES;
+      recurrence(job, begin, end, lane, s1, s2);
+      for(int l = 0; l < GOERTZEL_LANES; l++)
+      {
+        // y = sum x[j] e^{iw(end-j)}, one zero sample past the chunk; e^{-iw end} turns it
+        // into the chunk's share of X[k], the angle kept exact by reducing k*end mod n
+        double yr = job->cosines[lane + l] * s1[l] - s2[l];
+        double yi = job->sines[lane + l] * s1[l];
+        double angle = -2.0 * M_PI * (double)((job->bins[lane + l] * end) % job->n) / job->n;
+        double wr = cos(angle), wi = sin(angle);
+        out[2 * (lane + l)] = yr * wr - yi * wi;
+        out[2 * (lane + l) + 1] = yr * wi + yi * wr;
+      }
+    }
+  }
+}
+
+Goertzel::Goertzel(size_t n, const vector<size_t>& bins)
+    : n(n), bin_list(bins)
+{
+  size_t padded = (bins.size() + GOERTZEL_LANES - 1) / GOERTZEL_LANES * GOERTZEL_LANES;
+  coeffs.assign(padded, 0.0);
+  cosines.assign(padded, 0.0);
+  sines.assign(padded, 0.0);
+  for(size_t b = 0; b < bins.size(); b++)
+  {
+    double w = 2.0 * M_PI * (double)bins[b] / n;
+    cosines[b] = cos(w);
+    sines[b] = sin(w);
+    coeffs[b] = 2.0 * cosines[b];
+  }
+}
+
+bool Goertzel::cheaperThanFFT(size_t n, size_t num_bins)
+{
+  size_t lgN = 0;
+  while(((size_t)1 << lgN) < n)
+    lgN++;
+  return GOERTZEL_FLOPS * num_bins < FFT_FLOPS * lgN;
+}
+
+vector<Goertzel::Complex> Goertzel::evaluate(const float *samples) const
+{
+  CpuEngine &engine = CpuEngine::shared();
+  size_t padded = coeffs.size();
+  vector<size_t> bins(bin_list);
+  bins.resize(padded, 0);
+
+  // one chunk per thread, unless that leaves chunks too short to be worth the combine
+  size_t chunks = engine.numThreads();
+  if(chunks > n / 4096)
+    chunks = n / 4096 > 0 ? n / 4096 : 1;
+  vector<double> partials(2 * chunks * padded);
+
+  GoertzelJob job;
+  job.samples = samples;
+  job.n = n;
+  job.chunks = chunks;
+  job.groups = padded / GOERTZEL_LANES;
+  job.coeffs = &coeffs[0];
+  job.cosines = &cosines[0];
+  job.sines = &sines[0];
+  job.bins = &bins[0];
+  job.partials = &partials[0];
+  if(padded > 0)
+    engine.parallelFor(chunks, runChunks, &job);
+
+  vector<Complex> values(bin_list.size());
+  for(size_t b = 0; b < bin_list.size(); b++)
+  {
+    double re = 0.0, im = 0.0;
+    for(size_t chunk = 0; chunk < chunks; chunk++)
+    {
+      re += partials[2 * (chunk * padded + b)];
+      im += partials[2 * (chunk * padded + b) + 1];
+    }
+    values[b] = Complex((float)(re / n), (float)(im / n));
+  }
+  return values;
+}
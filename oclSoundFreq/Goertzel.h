@@ -0,0 +1,36 @@
+#ifndef _GOERTZEL_H_
+#define _GOERTZEL_H_
+
+#include <complex>
+#include <vector>
+
+/* Goertzel evaluation of a few bins of an n-point forward DFT of real samples,
+   for queries that only need a handful of known frequencies. n needs not be a
+   power of 2. The samples are cut into one chunk per CpuEngine thread and each
+   chunk runs the recurrence for four bins at a time (two SSE2 double lanes). */
+class Goertzel
+{
+    public:
+        typedef std::complex<float> Complex;
+
+        /* Prepares the given bins (each < n) of an n-point transform. */
+        Goertzel(size_t n, const std::vector<size_t>& bins);
+
+        /* True when num_bins recurrences over n samples cost less than the full transform. */
+        static bool cheaperThanFFT(size_t n, size_t num_bins);
+
+        /* X[bins[i]] / n of samples[0, n), scaled like FFT::transform. */
+        std::vector<Complex> evaluate(const float *samples) const;
+
+        const std::vector<size_t>& bins() const { return bin_list; }
+
+    private:
+        size_t n;
+        std::vector<size_t> bin_list;
+        /* per bin, padded to a multiple of 4: 2cos(w), cos(w), sin(w) with w = 2 pi k / n */
+        std::vector<double> coeffs;
+        std::vector<double> cosines;
+        std::vector<double> sines;
+};
+
+#endif
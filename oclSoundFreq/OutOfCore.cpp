@@ -0,0 +1,303 @@
+#include "OutOfCore.h"
+#include "Convolver.h"
+#include "oclFFT.h"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// twiddle recurrences are restarted from an exact angle this often
+#define TWIDDLE_RESEED 256
+
+using namespace std;
+
+static size_t sampleSize(OutOfCore::Format format)
+{
+  return (format == OutOfCore::PCM_S16) ? sizeof(short) : sizeof(cl_float2);
+}
+
+static void reverseTable(size_t n, vector<size_t>& table)
+{
+  table.resize(n);
+  for(size_t i = 0, j = 0; i < n; i++)
+  {
+    table[i] = j;
+    size_t bit = n >> 1;
+    for(; j & bit; bit >>= 1)
+      j ^= bit;
+    j |= bit;
+  }
+}
+
+// largest power of 2 not above limit, clamped to [1, cap]
+static size_t fitPower(size_t limit, size_t cap)
+{
+  size_t p = 1;
+  while(p * 2 <= limit && p * 2 <= cap)
+    p <<= 1;
+  return p;
+}
+
+OutOfCore::OutOfCore(Convolver& convolver, cl_context cxContext, cl_command_queue cqCommandQueue,
+                     size_t memory_points, const char *spill_dir)
+    : convolver(convolver), cxContext(cxContext), cqCommandQueue(cqCommandQueue),
+      memory_points(memory_points), spill_dir(spill_dir)
+{
+  cmBlock[0] = cmBlock[1] = NULL;
+}
+
+void OutOfCore::transform(const char *input_file, Format format, const char *output_file, size_t n, int dir,
+                          int argc, const char **argv)
+{
+  source_fd = open(input_file, O_RDONLY);
+  struct stat st;
+  if(source_fd < 0 || fstat(source_fd, &st) != 0 || (size_t)st.st_size < n * sampleSize(format))
+  {
+    shrLog("Couldn't read %u samples from %s\n", (unsigned int)n, input_file);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // a mapping lets the kernel page the input in, pread is the fallback
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, source_fd, 0);
+  source = (map == MAP_FAILED) ? NULL : (const char *)map;
+  this->format = format;
+  run(output_file, n, dir, argc, argv);
+
+  if(source)munmap(map, st.st_size);
+  close(source_fd);
+}
+
+void OutOfCore::transform(const void *input, Format format, const char *output_file, size_t n, int dir,
+                          int argc, const char **argv)
+{
+  source = (const char *)input;
+  source_fd = -1;
+  this->format = format;
+  run(output_file, n, dir, argc, argv);
+}
+
+void OutOfCore::run(const char *output_file, size_t n, int dir, int argc, const char **argv)
+{
+  assert(n >= 4 && (n & (n - 1)) == 0);
+  this->n = n;
+  this->dir = dir;
+  n1 = 1;
+  while(n1 * n1 * 2 <= n)
+    n1 <<= 1;
+  n2 = n / n1;
+
+  // four blocks in flight: two being read, one coming back from the device, one being written
+  size_t block_points = max(memory_points / 4, n2);
+  cols_per_block = fitPower(block_points / n1, n2);
+  rows_per_band = fitPower(block_points / n2, n1);
+  block_points = max(cols_per_block * n1, rows_per_band * n2);
+  reverseTable(n1, reverse_n1);
+  reverseTable(n2, reverse_n2);
+  staging.resize(4 * block_points);
+  segment.resize(max(cols_per_block * sampleSize(format), rows_per_band * cols_per_block * sizeof(cl_float2)));
+
+  cl_int ciErr;
+  cmBlock[0] = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * block_points, NULL, &ciErr);
+  cmBlock[1] = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * block_points, NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  char spill_name[1024];
+  snprintf(spill_name, sizeof(spill_name), "%s/oclSoundFreq.spill.XXXXXX", spill_dir);
+  spill_fd = mkstemp(spill_name);
+  output_fd = open(output_file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(spill_fd < 0 || output_fd < 0)
+  {
+    shrLog("Couldn't create the spill file in %s or %s\n", spill_dir, output_file);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  unlink(spill_name);
+
+  shrLog("Out of core: %u x %u, %u columns per block, %u rows per band\n", (unsigned int)n1, (unsigned int)n2,
+         (unsigned int)cols_per_block, (unsigned int)rows_per_band);
+  pipeline(n2 / cols_per_block, cols_per_block, n1, &OutOfCore::loadColumns, &OutOfCore::spillColumns, argc, argv);
+  pipeline(n1 / rows_per_band, rows_per_band, n2, &OutOfCore::loadRows, &OutOfCore::storeRows, argc, argv);
+
+  close(output_fd);
+  close(spill_fd);
+  clReleaseMemObject(cmBlock[0]);
+  clReleaseMemObject(cmBlock[1]);
+  cmBlock[0] = cmBlock[1] = NULL;
+}
+
+// Transforms count blocks of rows x length points. Block i+1 is loaded from storage
+// while block i is on the device.
+void OutOfCore::pipeline(size_t count, size_t rows, size_t length, BlockFn load, BlockFn store, int argc, const char **argv)
+{
+  size_t points = rows * length;
+  size_t stride = staging.size() / 4;
+  cl_float2 *host_in[2] = { &staging[0], &staging[stride] };
+  cl_float2 *host_out = &staging[2 * stride];
+
+  (this->*load)(0, host_in[0], argc, argv);
+  for(size_t i = 0; i < count; i++)
+  {
+    int cur = i & 1;
+    cl_event ceRead;
+    cl_int ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmBlock[cur], CL_FALSE, 0, sizeof(cl_float2) * points, host_in[cur], 0, NULL, NULL);
+    convolver.forward(cmBlock[cur], length, rows, argc, argv, dir);
+    ciErr |= clEnqueueReadBuffer(cqCommandQueue, cmBlock[cur], CL_FALSE, 0, sizeof(cl_float2) * points, host_out, 0, NULL, &ceRead);
+    ciErr |= clFlush(cqCommandQueue);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+
+    if(i + 1 < count)
+      (this->*load)(i + 1, host_in[cur ^ 1], argc, argv);
+
+    clWaitForEvents(1, &ceRead);
+    clReleaseEvent(ceRead);
+    (this->*store)(i, host_out, argc, argv);
+  }
+}
+
+// columns [block*B, block*B + B) of every row, as B rows of n1
+void OutOfCore::loadColumns(size_t block, cl_float2 *rows, int argc, const char **argv)
+{
+  size_t size = sampleSize(format);
+  size_t c0 = block * cols_per_block;
+  for(size_t r = 0; r < n1; r++)
+  {
+    size_t offset = (r * n2 + c0) * size;
+    const char *p = source ? source + offset : &segment[0];
+    if(!source)
+      readAt(source_fd, &segment[0], cols_per_block * size, offset, argc, argv);
+
+    if(format == PCM_S16)
+    {
+      const short *s = (const short *)p;
+      for(size_t b = 0; b < cols_per_block; b++)
+      {
+        rows[b * n1 + r].x = s[b];
+        rows[b * n1 + r].y = 0.0f;
+      }
+    }
+    else
+    {
+      const cl_float2 *c = (const cl_float2 *)p;
+      for(size_t b = 0; b < cols_per_block; b++)
+        rows[b * n1 + r] = c[b];
+    }
+  }
+}
+
+// Applies the twiddles W_n^(n2*k1) and spills the block as [k1][column], so the
+// row pass can fetch a band of k1 with one read per block.
+void OutOfCore::spillColumns(size_t block, cl_float2 *rows, int argc, const char **argv)
+{
+  size_t c0 = block * cols_per_block;
+  cl_float2 *out = &staging[3 * (staging.size() / 4)];
+  for(size_t b = 0; b < cols_per_block; b++)
+  {
+    size_t col = c0 + b;
+    double step_angle = -dir * 2.0 * M_PI * (double)col / n;
+    double step_re = cos(step_angle), step_im = sin(step_angle);
+    double w_re = 1.0, w_im = 0.0;
+    const cl_float2 *row = rows + b * n1;
+    for(size_t k1 = 0; k1 < n1; k1++)
+    {
+      if(k1 % TWIDDLE_RESEED == 0)
+      {
+        double angle = -dir * 2.0 * M_PI * (double)((col * k1) % n) / n;
+        w_re = cos(angle);
+        w_im = sin(angle);
+      }
+      cl_float2 v = row[reverse_n1[k1]];
+      out[k1 * cols_per_block + b].x = (float)(v.x * w_re - v.y * w_im);
+      out[k1 * cols_per_block + b].y = (float)(v.x * w_im + v.y * w_re);
+      double t = w_re * step_re - w_im * step_im;
+      w_im = w_re * step_im + w_im * step_re;
+      w_re = t;
+    }
+  }
+  writeAt(spill_fd, out, sizeof(cl_float2) * cols_per_block * n1, sizeof(cl_float2) * block * cols_per_block * n1, argc, argv);
+}
+
+// rows [band*R, band*R + R) of the twiddled column transforms, gathered from every spilled block
+void OutOfCore::loadRows(size_t band, cl_float2 *rows, int argc, const char **argv)
+{
+  size_t k0 = band * rows_per_band;
+  cl_float2 *chunk = (cl_float2 *)&segment[0];
+  for(size_t block = 0; block < n2 / cols_per_block; block++)
+  {
+    readAt(spill_fd, chunk, sizeof(cl_float2) * rows_per_band * cols_per_block,
+           sizeof(cl_float2) * (block * cols_per_block * n1 + k0 * cols_per_block), argc, argv);
+    for(size_t r = 0; r < rows_per_band; r++)
+      for(size_t b = 0; b < cols_per_block; b++)
+        rows[r * n2 + block * cols_per_block + b] = chunk[r * cols_per_block + b];
+  }
+}
+
+// X[k1 + n1*k2]: each k2 gets a run of R consecutive outputs
+void OutOfCore::storeRows(size_t band, cl_float2 *rows, int argc, const char **argv)
+{
+  size_t k0 = band * rows_per_band;
+  float scale = (dir > 0) ? 1.0f / n : 1.0f;
+  cl_float2 *out = &staging[3 * (staging.size() / 4)];
+  for(size_t k2 = 0; k2 < n2; k2++)
+  {
+    for(size_t r = 0; r < rows_per_band; r++)
+    {
+      cl_float2 v = rows[r * n2 + reverse_n2[k2]];
+      out[k2 * rows_per_band + r].x = v.x * scale;
+      out[k2 * rows_per_band + r].y = v.y * scale;
+    }
+  }
+
+  if(rows_per_band == n1)
+  {
+    writeAt(output_fd, out, sizeof(cl_float2) * n, 0, argc, argv);
+    return;
+  }
+  for(size_t k2 = 0; k2 < n2; k2++)
+    writeAt(output_fd, out + k2 * rows_per_band, sizeof(cl_float2) * rows_per_band,
+            sizeof(cl_float2) * (k2 * n1 + k0), argc, argv);
+}
+
+void OutOfCore::readAt(int fd, void *buf, size_t bytes, size_t offset, int argc, const char **argv)
+{
+  char *p = (char *)buf;
+  while(bytes > 0)
+  {
+    ssize_t got = pread(fd, p, bytes, offset);
+    if(got <= 0)
+    {
+      shrLog("Error in pread, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    p += got;
+    bytes -= got;
+    offset += got;
+  }
+}
+
+void OutOfCore::writeAt(int fd, const void *buf, size_t bytes, size_t offset, int argc, const char **argv)
+{
+  const char *p = (const char *)buf;
+  while(bytes > 0)
+  {
+    ssize_t put = pwrite(fd, p, bytes, offset);
+    if(put <= 0)
+    {
+      shrLog("Error in pwrite, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+    p += put;
+    bytes -= put;
+    offset += put;
+  }
+}
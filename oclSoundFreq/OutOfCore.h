@@ -0,0 +1,69 @@
+#ifndef _OUTOFCORE_H_
+#define _OUTOFCORE_H_
+
+#include <oclUtils.h>
+#include <vector>
+
+class Convolver;
+
+/* Four-step FFT for transforms that fit neither in host nor in device memory.
+   The n = N1 x N2 samples are seen as N1 rows of N2. The column pass reads
+   blocks of columns, transforms them on the device, applies the twiddles and
+   spills each block contiguously to a scratch file. The row pass reads those
+   blocks back a band of rows at a time, finishes the transform and writes the
+   result in natural order. Each pass streams the data once, and the disk reads
+   overlap the device work of the previous block. Like FFT, the forward
+   transform is scaled by 1/n. */
+class OutOfCore
+{
+    public:
+        enum Format { COMPLEX_FLOAT, PCM_S16 };
+
+        /* memory_points bounds the host and device working set (in complex points),
+           spill_dir is where the scratch file goes. */
+        OutOfCore(Convolver& convolver, cl_context cxContext, cl_command_queue cqCommandQueue,
+                  size_t memory_points, const char *spill_dir = ".");
+
+        /* Transforms the n samples of input_file (mapped when possible, read otherwise)
+           into output_file as n complex floats. n must be a power of 2. */
+        void transform(const char *input_file, Format format, const char *output_file, size_t n, int dir,
+                       int argc, const char **argv);
+        /* Same, reading the samples from a region the caller already mapped. */
+        void transform(const void *input, Format format, const char *output_file, size_t n, int dir,
+                       int argc, const char **argv);
+
+    private:
+        Convolver& convolver;
+        cl_context cxContext;
+        cl_command_queue cqCommandQueue;
+        size_t memory_points;
+        const char *spill_dir;
+
+        // state of the transform in progress
+        const char *source;         /* mapped input, NULL when it is read with pread */
+        int source_fd;
+        Format format;
+        int spill_fd;
+        int output_fd;
+        size_t n, n1, n2;
+        size_t cols_per_block;      /* column pass: columns per block */
+        size_t rows_per_band;       /* row pass: rows per band */
+        int dir;
+        std::vector<size_t> reverse_n1, reverse_n2;
+        std::vector<char> segment;
+        std::vector<cl_float2> staging;
+        cl_mem cmBlock[2];
+
+        typedef void (OutOfCore::*BlockFn)(size_t index, cl_float2 *rows, int argc, const char **argv);
+
+        void run(const char *output_file, size_t n, int dir, int argc, const char **argv);
+        void pipeline(size_t count, size_t rows, size_t length, BlockFn load, BlockFn store, int argc, const char **argv);
+        void loadColumns(size_t block, cl_float2 *rows, int argc, const char **argv);
+        void spillColumns(size_t block, cl_float2 *rows, int argc, const char **argv);
+        void loadRows(size_t band, cl_float2 *rows, int argc, const char **argv);
+        void storeRows(size_t band, cl_float2 *rows, int argc, const char **argv);
+        void readAt(int fd, void *buf, size_t bytes, size_t offset, int argc, const char **argv);
+        void writeAt(int fd, const void *buf, size_t bytes, size_t offset, int argc, const char **argv);
+};
+
+#endif
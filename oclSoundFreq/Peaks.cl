@@ -0,0 +1,149 @@
+// Post-processing of a device resident spectrum: per-bin magnitude or power,
+// then either every bin above a threshold or the k largest bins, so only the
+// (bin, value) peaks leave the device. PEAKS_MAX_K is set by the host.
+
+#pragma OPENCL EXTENSION cl_khr_global_int32_base_atomics : enable
+
+#ifndef PEAKS_MAX_K
+  #define PEAKS_MAX_K 32
+#endif
+
+typedef struct
+{
+  uint bin;
+  float value;
+} peak;
+
+// |scale * a[i]| or its square
+float bin_value(__global const float2 * spectrum, uint i, float scale, int power)
+{
+  float2 v = spectrum[i] * scale;
+  float p = v.s0*v.s0 + v.s1*v.s1;
+  return power ? p : sqrt(p);
+}
+
+// adds (bin, value) to a private list of k entries kept largest first; empty entries are -1
+void insert_peak(uint * bins, float * values, uint k, uint bin, float value)
+{
+  if(value <= values[k - 1])
+    return;
+  uint j = k - 1;
+  for(; j > 0 && values[j - 1] < value; --j)
+  {
+    bins[j] = bins[j - 1];
+    values[j] = values[j - 1];
+  }
+  bins[j] = bin;
+  values[j] = value;
+}
+
+// merges the work-items' private lists through local memory by halving, then
+// work-item 0 writes the group's k largest to out[group * k]
+void reduce_group(__local peak * scratch, uint * bins, float * values, uint k, __global peak * out)
+{
+  uint lid = get_local_id(0);
+  for(uint j = 0; j < k; ++j)
+  {
+    scratch[lid * k + j].bin = bins[j];
+    scratch[lid * k + j].value = values[j];
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for(uint stride = get_local_size(0) >> 1; stride > 0; stride >>= 1)
+  {
+    if(lid < stride)
+    {
+      __local peak * a = scratch + lid * k;
+      __local peak * b = scratch + (lid + stride) * k;
+      uint ia = 0, ib = 0;
+      for(uint j = 0; j < k; ++j)
+      {
+        if(a[ia].value >= b[ib].value)
+        {
+          bins[j] = a[ia].bin;
+          values[j] = a[ia].value;
+          ++ia;
+        }
+        else
+        {
+          bins[j] = b[ib].bin;
+          values[j] = b[ib].value;
+          ++ib;
+        }
+      }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if(lid < stride)
+    {
+      for(uint j = 0; j < k; ++j)
+      {
+        scratch[lid * k + j].bin = bins[j];
+        scratch[lid * k + j].value = values[j];
+      }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  if(lid == 0)
+  {
+    for(uint j = 0; j < k; ++j)
+      out[get_group_id(0) * k + j] = scratch[j];
+  }
+}
+
+// every bin of the first `bins` whose value exceeds threshold; at most max_peaks are
+// stored, count ends up with the total, the order is whatever the atomics gave
+__kernel void PEAKS_THRESHOLD(__global const float2 * spectrum, const uint bins, const float scale, const int power,
+                              const float threshold, const uint max_peaks, __global uint * count, __global peak * out)
+{
+  uint i = get_global_id(0);
+  if(i >= bins)
+    return;
+  float value = bin_value(spectrum, i, scale, power);
+  if(value > threshold)
+  {
+    uint slot = atomic_inc(count);
+    if(slot < max_peaks)
+    {
+      out[slot].bin = i;
+      out[slot].value = value;
+    }
+  }
+}
+
+// first pass of the top-k: each group strides over the bins and leaves its k largest
+// (largest first) in out; the local size must be a power of 2
+__kernel void PEAKS_TOPK(__global const float2 * spectrum, const uint bins, const float scale, const int power,
+                         const uint k, __local peak * scratch, __global peak * out)
+{
+  uint top_bins[PEAKS_MAX_K];
+  float top_values[PEAKS_MAX_K];
+  for(uint j = 0; j < k; ++j)
+  {
+    top_bins[j] = 0;
+    top_values[j] = -1.0f;
+  }
+
+  for(uint i = get_global_id(0); i < bins; i += get_global_size(0))
+    insert_peak(top_bins, top_values, k, i, bin_value(spectrum, i, scale, power));
+
+  reduce_group(scratch, top_bins, top_values, k, out);
+}
+
+// second pass: one group merges the count candidates of the first pass into the k largest
+__kernel void PEAKS_TOPK_MERGE(__global const peak * candidates, const uint count, const uint k,
+                               __local peak * scratch, __global peak * out)
+{
+  uint top_bins[PEAKS_MAX_K];
+  float top_values[PEAKS_MAX_K];
+  for(uint j = 0; j < k; ++j)
+  {
+    top_bins[j] = 0;
+    top_values[j] = -1.0f;
+  }
+
+  for(uint i = get_local_id(0); i < count; i += get_local_size(0))
+    insert_peak(top_bins, top_values, k, candidates[i].bin, candidates[i].value);
+
+  reduce_group(scratch, top_bins, top_values, k, out);
+}
@@ -0,0 +1,218 @@
+#include "Peaks.h"
+#include "oclFFT.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#define TOPK_GROUPS 64
+
+using namespace std;
+
+static bool byBin(const Peak& a, const Peak& b)
+{
+  return a.bin < b.bin;
+}
+
+Peaks::Peaks(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue, int argc, const char **argv)
+    : cxContext(cxContext), cqCommandQueue(cqCommandQueue), cmPeaks(NULL), cmCandidates(NULL),
+      peak_capacity(0), candidate_capacity(0)
+{
+  cl_int ciErr;
+  size_t szKernelLength;
+  char* cPathAndName = shrFindFilePath("Peaks.cl", argv[0]);
+  cSourceCL = oclLoadProgSource(cPathAndName, "", &szKernelLength);
+  free(cPathAndName);
+
+  char flags[32];
+  sprintf(flags, "-DPEAKS_MAX_K=%d", PEAKS_MAX_K);
+
+  cpProgram = clCreateProgramWithSource(cxContext, 1, (const char **)&cSourceCL, &szKernelLength, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateProgramWithSource, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  ciErr = clBuildProgram(cpProgram, 1, &cdDevice, flags, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    size_t log_size;
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+    char* program_log = (char *)malloc(log_size + 1);
+    program_log[log_size] = '\0';
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, log_size + 1, program_log, NULL);
+    printf("%s\n", program_log);
+    free(program_log);
+    shrLog("Error in clBuildProgram, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ckThreshold = clCreateKernel(cpProgram, "PEAKS_THRESHOLD", &ciErr);
+  ckTopK = clCreateKernel(cpProgram, "PEAKS_TOPK", &ciErr);
+  ckTopKMerge = clCreateKernel(cpProgram, "PEAKS_TOPK_MERGE", &ciErr);
+  // each call overwrites ciErr, but a failed one leaves its kernel NULL
+  if (ckThreshold == NULL || ckTopK == NULL || ckTopKMerge == NULL)
+  {
+    shrLog("Error in clCreateKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  cmCount = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // the top-k group: up to 64 work-items, a power of 2, within both kernels' limits
+  size_t topk_items, merge_items;
+  ciErr = clGetKernelWorkGroupInfo(ckTopK, cdDevice, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), (void *)&topk_items, NULL);
+  ciErr |= clGetKernelWorkGroupInfo(ckTopKMerge, cdDevice, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), (void *)&merge_items, NULL);
+  ciErr |= clGetDeviceInfo(cdDevice, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), (void *)&local_memory_size, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clGetKernelWorkGroupInfo, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  group_size = 1;
+  while(group_size < 64 && 2 * group_size <= min(topk_items, merge_items))
+    group_size <<= 1;
+}
+
+Peaks::~Peaks()
+{
+  if(cmCandidates)clReleaseMemObject(cmCandidates);
+  if(cmPeaks)clReleaseMemObject(cmPeaks);
+  if(cmCount)clReleaseMemObject(cmCount);
+  if(ckTopKMerge)clReleaseKernel(ckTopKMerge);
+  if(ckTopK)clReleaseKernel(ckTopK);
+  if(ckThreshold)clReleaseKernel(ckThreshold);
+  if(cpProgram)clReleaseProgram(cpProgram);
+  if(cSourceCL)free(cSourceCL);
+}
+
+void Peaks::reserve(cl_mem& cmBuffer, size_t& capacity, size_t peaks, int argc, const char **argv)
+{
+  if(peaks <= capacity)
+    return;
+
+  cl_int ciErr;
+  if(cmBuffer)clReleaseMemObject(cmBuffer);
+  cmBuffer = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(Peak) * peaks, NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  capacity = peaks;
+}
+
+void Peaks::enqueue(cl_kernel ckKernel, size_t szGlobalWorkSize, size_t szLocalWorkSize, int argc, const char **argv)
+{
+  cl_int ciErr = clEnqueueNDRangeKernel(cqCommandQueue, ckKernel, 1, NULL, &szGlobalWorkSize,
+                                        szLocalWorkSize ? &szLocalWorkSize : NULL, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
+
+size_t Peaks::threshold(cl_mem cmSpectrum, size_t bins, float scale, Measure measure, float threshold,
+                        size_t max_peaks, vector<Peak>& peaks, int argc, const char **argv)
+{
+  cl_int ciErr;
+  cl_uint count = 0;
+  cl_uint points = (cl_uint)bins;
+  cl_int power = (measure == POWER);
+  cl_uint max_out = (cl_uint)max_peaks;
+  reserve(cmPeaks, peak_capacity, max_peaks > 0 ? max_peaks : 1, argc, argv);
+
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmCount, CL_FALSE, 0, sizeof(cl_uint), &count, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ciErr = clSetKernelArg(ckThreshold, 0, sizeof(cl_mem), (void*)&cmSpectrum);
+  ciErr |= clSetKernelArg(ckThreshold, 1, sizeof(cl_uint), (void*)&points);
+  ciErr |= clSetKernelArg(ckThreshold, 2, sizeof(cl_float), (void*)&scale);
+  ciErr |= clSetKernelArg(ckThreshold, 3, sizeof(cl_int), (void*)&power);
+  ciErr |= clSetKernelArg(ckThreshold, 4, sizeof(cl_float), (void*)&threshold);
+  ciErr |= clSetKernelArg(ckThreshold, 5, sizeof(cl_uint), (void*)&max_out);
+  ciErr |= clSetKernelArg(ckThreshold, 6, sizeof(cl_mem), (void*)&cmCount);
+  ciErr |= clSetKernelArg(ckThreshold, 7, sizeof(cl_mem), (void*)&cmPeaks);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  enqueue(ckThreshold, (bins + group_size - 1) / group_size * group_size, group_size, argc, argv);
+
+  // the count first, then only as many peaks as were found
+  ciErr = clEnqueueReadBuffer(cqCommandQueue, cmCount, CL_TRUE, 0, sizeof(cl_uint), &count, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  peaks.resize(min((size_t)count, max_peaks));
+  if(!peaks.empty())
+  {
+    ciErr = clEnqueueReadBuffer(cqCommandQueue, cmPeaks, CL_TRUE, 0, sizeof(Peak) * peaks.size(), &peaks[0], 0, NULL, NULL);
+    if (ciErr != CL_SUCCESS)
+    {
+      shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+      Cleanup(argc, (char **)argv, EXIT_FAILURE);
+    }
+  }
+  sort(peaks.begin(), peaks.end(), byBin);
+  return count;
+}
+
+void Peaks::topK(cl_mem cmSpectrum, size_t bins, float scale, Measure measure, size_t k,
+                 vector<Peak>& peaks, int argc, const char **argv)
+{
+  cl_int ciErr;
+  k = min(min(k, (size_t)PEAKS_MAX_K), bins);
+  cl_uint points = (cl_uint)bins;
+  cl_int power = (measure == POWER);
+  cl_uint keep = (cl_uint)k;
+
+  // one list of k per work-item in local memory
+  size_t items = group_size;
+  while(items > 1 && sizeof(Peak) * k * items > local_memory_size / 2)
+    items >>= 1;
+  size_t groups = min((size_t)TOPK_GROUPS, (bins + items - 1) / items);
+  cl_uint candidates = (cl_uint)(groups * k);
+  reserve(cmCandidates, candidate_capacity, candidates, argc, argv);
+  reserve(cmPeaks, peak_capacity, k, argc, argv);
+
+  ciErr = clSetKernelArg(ckTopK, 0, sizeof(cl_mem), (void*)&cmSpectrum);
+  ciErr |= clSetKernelArg(ckTopK, 1, sizeof(cl_uint), (void*)&points);
+  ciErr |= clSetKernelArg(ckTopK, 2, sizeof(cl_float), (void*)&scale);
+  ciErr |= clSetKernelArg(ckTopK, 3, sizeof(cl_int), (void*)&power);
+  ciErr |= clSetKernelArg(ckTopK, 4, sizeof(cl_uint), (void*)&keep);
+  ciErr |= clSetKernelArg(ckTopK, 5, sizeof(Peak) * k * items, NULL);
+  ciErr |= clSetKernelArg(ckTopK, 6, sizeof(cl_mem), (void*)&cmCandidates);
+  ciErr |= clSetKernelArg(ckTopKMerge, 0, sizeof(cl_mem), (void*)&cmCandidates);
+  ciErr |= clSetKernelArg(ckTopKMerge, 1, sizeof(cl_uint), (void*)&candidates);
+  ciErr |= clSetKernelArg(ckTopKMerge, 2, sizeof(cl_uint), (void*)&keep);
+  ciErr |= clSetKernelArg(ckTopKMerge, 3, sizeof(Peak) * k * items, NULL);
+  ciErr |= clSetKernelArg(ckTopKMerge, 4, sizeof(cl_mem), (void*)&cmPeaks);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  enqueue(ckTopK, groups * items, items, argc, argv);
+  enqueue(ckTopKMerge, items, items, argc, argv);
+
+  peaks.resize(k);
+  ciErr = clEnqueueReadBuffer(cqCommandQueue, cmPeaks, CL_TRUE, 0, sizeof(Peak) * k, &peaks[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
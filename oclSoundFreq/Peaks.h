@@ -0,0 +1,58 @@
+#ifndef _PEAKS_H_
+#define _PEAKS_H_
+
+#include <oclUtils.h>
+#include <vector>
+
+/* Largest k the top-k kernels keep per work-item (their private lists). */
+#define PEAKS_MAX_K 32
+
+/* One spectral peak, laid out like the peak struct of Peaks.cl. */
+struct Peak
+{
+    cl_uint bin;
+    cl_float value;
+};
+
+/* Peak extraction on a spectrum that is still on the device (Peaks.cl). The
+   magnitude or power of every bin is computed and reduced there, and only the
+   selected (bin, value) pairs are read back instead of the whole spectrum. */
+class Peaks
+{
+    public:
+        enum Measure { MAGNITUDE, POWER };
+
+        /* Builds Peaks.cl for the device behind cqCommandQueue. */
+        Peaks(cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue, int argc, const char **argv);
+        ~Peaks();
+
+        /* Bins among the first bins points of cmSpectrum (float2) whose measure of
+           scale * value exceeds threshold, in bin order. At most max_peaks are read back;
+           the return value is how many bins were above the threshold. */
+        size_t threshold(cl_mem cmSpectrum, size_t bins, float scale, Measure measure, float threshold,
+                         size_t max_peaks, std::vector<Peak>& peaks, int argc, const char **argv);
+        /* The k (at most PEAKS_MAX_K) largest bins, largest first. */
+        void topK(cl_mem cmSpectrum, size_t bins, float scale, Measure measure, size_t k,
+                  std::vector<Peak>& peaks, int argc, const char **argv);
+
+    private:
+        cl_context cxContext;
+        cl_command_queue cqCommandQueue;
+        cl_program cpProgram;
+        cl_kernel ckThreshold;
+        cl_kernel ckTopK;
+        cl_kernel ckTopKMerge;
+        cl_mem cmCount;
+        cl_mem cmPeaks;
+        cl_mem cmCandidates;
+        size_t peak_capacity;
+        size_t candidate_capacity;
+        size_t group_size;      /* power of 2 work-group of the top-k kernels */
+        cl_ulong local_memory_size;
+        char* cSourceCL;
+
+        void reserve(cl_mem& cmBuffer, size_t& capacity, size_t peaks, int argc, const char **argv);
+        void enqueue(cl_kernel ckKernel, size_t szGlobalWorkSize, size_t szLocalWorkSize, int argc, const char **argv);
+};
+
+#endif
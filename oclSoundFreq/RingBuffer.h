@@ -0,0 +1,85 @@
+#ifndef _RINGBUFFER_H_
+#define _RINGBUFFER_H_
+
+#include <cstddef>
+
+/* Lock-free ring of T for exactly one producer thread and one consumer thread.
+   head and tail only ever grow and are each written by one side, so the two
+   sides never wait on each other; a full barrier orders the copy of the items
+   before the index that publishes them. The capacity is a power of 2. */
+template <class T>
+class RingBuffer
+{
+    public:
+        /* Room for at least capacity items. */
+        explicit RingBuffer(size_t capacity) : head(0), tail(0)
+        {
+            size_t size = 1;
+            while(size < capacity)
+                size <<= 1;
+            mask = size - 1;
+            items = new T[size];
+        }
+        ~RingBuffer() { delete[] items; }
+
+        /* Producer: stores up to count items and returns how many fitted. */
+        size_t write(const T *data, size_t count)
+        {
+            size_t h = head;
+            size_t t = tail;
+            __sync_synchronize();
+            size_t room = mask + 1 - (h - t);
+            if(count > room)
+                count = room;
+            for(size_t i = 0; i < count; i++)
+                items[(h + i) & mask] = data[i];
+            __sync_synchronize();
+            head = h + count;
+            return count;
+        }
+
+        /* Consumer: takes up to count items and returns how many there were. */
+        size_t read(T *data, size_t count)
+        {
+            size_t t = tail;
+            size_t h = head;
+            __sync_synchronize();
+            if(count > h - t)
+                count = h - t;
+            for(size_t i = 0; i < count; i++)
+                data[i] = items[(t + i) & mask];
+            __sync_synchronize();
+            tail = t + count;
+            return count;
+        }
+
+        /* Consumer: the oldest item, left in the ring. False when it is empty. */
+        bool peek(T &item) const
+        {
+            size_t t = tail;
+            if(head == t)
+                return false;
+            __sync_synchronize();
+            item = items[t & mask];
+            return true;
+        }
+
+        /* Items waiting; exact on the consumer side, a lower bound elsewhere. */
+        size_t available() const { return head - tail; }
+        size_t capacity() const { return mask + 1; }
+
+    private:
+        T *items;
+        size_t mask;
+        /* each index on its own cache line, so the two sides don't bounce one line between cores */
+        char pad0[64];
+        volatile size_t head;
+        char pad1[64];
+        volatile size_t tail;
+        char pad2[64];
+
+        RingBuffer(const RingBuffer &);
+        RingBuffer &operator=(const RingBuffer &);
+};
+
+#endif
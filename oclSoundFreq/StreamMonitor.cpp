@@ -0,0 +1,260 @@
+#include "StreamMonitor.h"
+#include "Convolver.h"
+#include "oclFFT.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define READ_BYTES 4096
+#define IDLE_US 100
+
+using namespace std;
+
+static double wallclock(void)
+{
+  struct timeval tim;
+  gettimeofday(&tim, NULL);
+  return (double)tim.tv_sec*1000000 + (double)tim.tv_usec;
+}
+
+// index of the natural order point i in a bit reversed row of n points
+static size_t reverseBits(size_t i, size_t n)
+{
+  size_t rev = 0;
+  for(size_t m = n; m > 1; m >>= 1)
+  {
+    rev = (rev << 1) | (i & 1);
+    i >>= 1;
+  }
+  return rev;
+}
+
+StreamMonitor::StreamMonitor(Convolver& convolver, cl_context cxContext, cl_command_queue cqCommandQueue,
+                             size_t n, size_t batch, size_t ring_frames, double sample_rate, int argc, const char **argv)
+    : convolver(convolver), cqCommandQueue(cqCommandQueue), n(n), batch(batch > 0 ? batch : 1),
+      sample_rate(sample_rate), samples(n * max(ring_frames, batch)), arrivals(n * max(ring_frames, batch) + 1),
+      fd(-1), verbose(false), eof(false), dropped_samples(0), consumed(0), argc(argc), argv(argv),
+      frames(0), latency_sum(0.0), latency_min(0.0), latency_max(0.0)
+{
+  assert(n >= 2 && Convolver::transformSize(n) == n);
+
+  cl_int ciErr;
+  cmFrames = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n * this->batch, NULL, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  recent.reserve(LATENCY_WINDOW);
+  pthread_mutex_init(&stats_lock, NULL);
+}
+
+StreamMonitor::~StreamMonitor()
+{
+  pthread_mutex_destroy(&stats_lock);
+  if(cmFrames)clReleaseMemObject(cmFrames);
+}
+
+int StreamMonitor::openInput(const char *spec)
+{
+  if(strcmp(spec, "-") == 0)
+    return 0;
+  if(strncmp(spec, "unix:", 5) == 0)
+  {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(spec + 5) >= sizeof(addr.sun_path))
+      return -1;
+    strcpy(addr.sun_path, spec + 5);
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(s >= 0 && connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+      close(s);
+      s = -1;
+    }
+    return s;
+  }
+  return open(spec, O_RDONLY);
+}
+
+void StreamMonitor::run(int fd, bool verbose, int argc, const char **argv)
+{
+  this->fd = fd;
+  this->verbose = verbose;
+  this->argc = argc;
+  this->argv = argv;
+  eof = false;
+
+  pthread_t reader, consumer;
+  pthread_create(&reader, NULL, readerMain, this);
+  pthread_create(&consumer, NULL, consumerMain, this);
+  pthread_join(reader, NULL);
+  pthread_join(consumer, NULL);
+}
+
+void *StreamMonitor::readerMain(void *arg)
+{
+  ((StreamMonitor *)arg)->readInput();
+  return NULL;
+}
+
+void *StreamMonitor::consumerMain(void *arg)
+{
+  ((StreamMonitor *)arg)->consumeFrames();
+  return NULL;
+}
+
+// Producer: whole samples go into the ring as they arrive, followed by where they end
+// and when; a byte of a sample split between two reads waits for the next one.
+void StreamMonitor::readInput()
+{
+  char bytes[READ_BYTES + 1];
+  size_t carry = 0;
+  size_t written = 0;
+  while(true)
+  {
+    ssize_t got = read(fd, bytes + carry, READ_BYTES);
+    if(got < 0 && errno == EINTR)
+      continue;
+    if(got <= 0)
+      break;
+    size_t total = carry + got;
+    size_t count = total / sizeof(short);
+    short pcm[READ_BYTES / sizeof(short) + 1];
+    memcpy(pcm, bytes, count * sizeof(short));
+    carry = total - count * sizeof(short);
+    if(carry)
+      bytes[0] = bytes[total - 1];
+
+    size_t stored = samples.write(pcm, count);
+    dropped_samples += count - stored;
+    if(stored > 0)
+    {
+      written += stored;
+      Arrival a;
+      a.end = written;
+      a.time_us = wallclock();
+      arrivals.write(&a, 1);
+    }
+  }
+  __sync_synchronize();
+  eof = true;
+}
+
+// Consumer: every whole frame in the ring, up to batch of them, per device pass.
+void StreamMonitor::consumeFrames()
+{
+  vector<short> pcm(n * batch);
+  vector<cl_float2> staging(n * batch);
+  while(true)
+  {
+    bool done = eof;
+    __sync_synchronize();
+    size_t ready = samples.available() / n;
+    if(ready == 0)
+    {
+      if(done)
+        break;
+      usleep(IDLE_US);
+      continue;
+    }
+    runBatch(min(ready, batch), pcm, staging);
+  }
+}
+
+void StreamMonitor::runBatch(size_t rows, vector<short>& pcm, vector<cl_float2>& staging)
+{
+  samples.read(&pcm[0], rows * n);
+  for(size_t i = 0; i < rows * n; i++)
+  {
+    staging[i].x = pcm[i];
+    staging[i].y = 0.0f;
+  }
+
+  cl_int ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmFrames, CL_FALSE, 0, sizeof(cl_float2) * n * rows, &staging[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  convolver.forward(cmFrames, n, rows, argc, argv);
+  ciErr = clEnqueueReadBuffer(cqCommandQueue, cmFrames, CL_TRUE, 0, sizeof(cl_float2) * n * rows, &staging[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  double now = wallclock();
+
+  for(size_t r = 0; r < rows; r++)
+  {
+    // the first write that reached the end of this frame brought its last sample
+    size_t end = consumed + (r + 1) * n;
+    Arrival a;
+    a.time_us = now;
+    while(arrivals.peek(a) && a.end < end)
+      arrivals.read(&a, 1);
+    recordLatency(now - a.time_us);
+
+    if(verbose)
+    {
+      size_t strongest = 1;
+      float best = 0.0f;
+      for(size_t k = 1; k <= n / 2; k++)
+      {
+        cl_float2 v = staging[r * n + reverseBits(k, n)];
+        float p = v.x * v.x + v.y * v.y;
+        if(p > best)
+        {
+          best = p;
+          strongest = k;
+        }
+      }
+      printf("frame %u: %g => %g, latency %.0f us\n", (unsigned int)(end / n - 1),
+             strongest * sample_rate / n, sqrt(best) / n, now - a.time_us);
+    }
+  }
+  consumed += rows * n;
+}
+
+void StreamMonitor::recordLatency(double latency_us)
+{
+  pthread_mutex_lock(&stats_lock);
+  if(frames == 0 || latency_us < latency_min)
+    latency_min = latency_us;
+  if(frames == 0 || latency_us > latency_max)
+    latency_max = latency_us;
+  latency_sum += latency_us;
+  if(recent.size() < LATENCY_WINDOW)
+    recent.push_back(latency_us);
+  else
+    recent[frames % LATENCY_WINDOW] = latency_us;
+  frames++;
+  pthread_mutex_unlock(&stats_lock);
+}
+
+LatencyStats StreamMonitor::latency() const
+{
+  pthread_mutex_lock(&stats_lock);
+  LatencyStats stats;
+  vector<double> sorted(recent);
+  stats.frames = frames;
+  stats.min_us = latency_min;
+  stats.max_us = latency_max;
+  stats.mean_us = frames ? latency_sum / frames : 0.0;
+  pthread_mutex_unlock(&stats_lock);
+
+  sort(sorted.begin(), sorted.end());
+  stats.p50_us = sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+  stats.p99_us = sorted.empty() ? 0.0 : sorted[min(sorted.size() - 1, sorted.size() * 99 / 100)];
+  return stats;
+}
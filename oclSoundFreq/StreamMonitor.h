@@ -0,0 +1,90 @@
+#ifndef _STREAMMONITOR_H_
+#define _STREAMMONITOR_H_
+
+#include <oclUtils.h>
+#include <pthread.h>
+#include <vector>
+#include "RingBuffer.h"
+
+class Convolver;
+
+/* Latency of the frames so far: from the arrival of a frame's last sample in the
+   ring to its spectrum being back on the host, in microseconds. The percentiles
+   cover the last LATENCY_WINDOW frames. */
+#define LATENCY_WINDOW 4096
+struct LatencyStats
+{
+    size_t frames;
+    double min_us;
+    double mean_us;
+    double p50_us;
+    double p99_us;
+    double max_us;
+};
+
+/* Continuous spectrum of 16-bit mono PCM arriving on a file descriptor. A reader
+   thread moves the samples into a lock-free ring (RingBuffer) and a consumer thread
+   takes every whole frame of n samples waiting there as one batch through the device
+   (Convolver), so batches stay single frames while the device keeps up and grow
+   when it falls behind. When the ring is full the reader drops samples rather than
+   stall the source; the count is kept. */
+class StreamMonitor
+{
+    public:
+        /* n is a power of 2, at most batch frames go to the device at once and the
+           ring holds ring_frames frames. */
+        StreamMonitor(Convolver& convolver, cl_context cxContext, cl_command_queue cqCommandQueue,
+                      size_t n, size_t batch, size_t ring_frames, double sample_rate, int argc, const char **argv);
+        ~StreamMonitor();
+
+        /* "-" for stdin, "unix:path" for a Unix stream socket, anything else is opened
+           as a file (a FIFO included). Returns the descriptor, or -1. */
+        static int openInput(const char *spec);
+
+        /* Reads fd until end of stream, printing the strongest bin of every frame when
+           verbose, and returns once the last whole frame is done. */
+        void run(int fd, bool verbose, int argc, const char **argv);
+
+        LatencyStats latency() const;
+        size_t dropped() const { return dropped_samples; }
+
+    private:
+        /* Where the last write of the reader ended in the stream and when. */
+        struct Arrival
+        {
+            size_t end;
+            double time_us;
+        };
+
+        Convolver& convolver;
+        cl_command_queue cqCommandQueue;
+        cl_mem cmFrames;            /* batch rows of n points */
+        size_t n;
+        size_t batch;
+        double sample_rate;
+        RingBuffer<short> samples;
+        RingBuffer<Arrival> arrivals;
+        int fd;
+        bool verbose;
+        volatile bool eof;
+        size_t dropped_samples;     /* written by the reader only */
+        size_t consumed;            /* samples taken from the ring, written by the consumer only */
+        int argc;
+        const char **argv;
+
+        mutable pthread_mutex_t stats_lock;
+        size_t frames;
+        double latency_sum;
+        double latency_min;
+        double latency_max;
+        std::vector<double> recent; /* ring of the last LATENCY_WINDOW latencies */
+
+        static void *readerMain(void *arg);
+        static void *consumerMain(void *arg);
+        void readInput();
+        void consumeFrames();
+        void runBatch(size_t rows, std::vector<short>& pcm, std::vector<cl_float2>& staging);
+        void recordLatency(double latency_us);
+};
+
+#endif
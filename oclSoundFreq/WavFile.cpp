@@ -0,0 +1,165 @@
+#include "WavFile.h"
+#include <cstring>
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+#define READ_FRAMES 4096
+
+using namespace std;
+
+// RIFF fields are little endian whatever the host
+static unsigned int le16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static unsigned int le32(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+WavFile::WavFile() : f(NULL), frames_left(0)
+{
+  memset(&fmt, 0, sizeof(fmt));
+}
+
+WavFile::~WavFile()
+{
+  close();
+}
+
+void WavFile::close()
+{
+  if(f)fclose(f);
+  f = NULL;
+  frames_left = 0;
+}
+
+bool WavFile::open(const char *path)
+{
+  close();
+  f = fopen(path, "rb");
+  if(f == NULL)
+  {
+    shrLog("Couldn't open %s\n", path);
+    return false;
+  }
+
+  unsigned char header[12];
+  if(fread(header, 1, 12, f) != 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+  {
+    shrLog("%s is not a RIFF/WAVE file\n", path);
+    close();
+    return false;
+  }
+
+  // chunks in any order; fmt has to come before data
+  bool have_fmt = false;
+  unsigned char chunk[8];
+  while(fread(chunk, 1, 8, f) == 8)
+  {
+    unsigned int size = le32(chunk + 4);
+    if(memcmp(chunk, "fmt ", 4) == 0)
+    {
+      vector<unsigned char> body(size < 16 ? 16 : size, 0);
+      if(size < 16 || fread(&body[0], 1, size, f) != size)
+        break;
+      unsigned int tag = le16(&body[0]);
+      if(tag == WAVE_FORMAT_EXTENSIBLE && size >= 26)
+        tag = le16(&body[24]);      // first two bytes of the SubFormat GUID
+      fmt.channels = le16(&body[2]);
+      fmt.sample_rate = le32(&body[4]);
+      fmt.block_align = le16(&body[12]);
+      fmt.bits = le16(&body[14]);
+      fmt.is_float = (tag == WAVE_FORMAT_IEEE_FLOAT);
+      bool supported = fmt.channels > 0 && fmt.block_align == fmt.channels * (fmt.bits / 8) &&
+                       ((tag == WAVE_FORMAT_PCM && (fmt.bits == 16 || fmt.bits == 24 || fmt.bits == 32)) ||
+                        (tag == WAVE_FORMAT_IEEE_FLOAT && (fmt.bits == 32 || fmt.bits == 64)));
+      if(!supported)
+      {
+        shrLog("%s: unsupported format %u with %u bits in %u channels\n", path, tag, fmt.bits, fmt.channels);
+        close();
+        return false;
+      }
+      have_fmt = true;
+      if(size & 1)
+        fseek(f, 1, SEEK_CUR);
+    }
+    else if(memcmp(chunk, "data", 4) == 0 && have_fmt)
+    {
+      fmt.frames = size / fmt.block_align;
+      frames_left = fmt.frames;
+      return true;
+    }
+    else if(fseek(f, size + (size & 1), SEEK_CUR) != 0)
+      break;
+  }
+  shrLog("%s: no fmt and data chunks\n", path);
+  close();
+  return false;
+}
+
+float WavFile::decode(const unsigned char *p) const
+{
+  if(fmt.is_float)
+  {
+    if(fmt.bits == 32)
+    {
+      unsigned int u = le32(p);
+      float v;
+      memcpy(&v, &u, sizeof(v));
+      return v * 32768.0f;
+    }
+    unsigned long long u = le32(p) | ((unsigned long long)le32(p + 4) << 32);
+    double v;
+    memcpy(&v, &u, sizeof(v));
+    return (float)(v * 32768.0);
+  }
+  switch(fmt.bits)
+  {
+    case 16:
+      return (float)(short)le16(p);
+    case 24:
+      // sign extend through the top byte of an int
+      return (float)((int)((p[0] << 8) | (p[1] << 16) | ((unsigned int)p[2] << 24)) >> 8) / 256.0f;
+    default:
+      return (float)(int)le32(p) / 65536.0f;
+  }
+}
+
+size_t WavFile::readFrames(cl_float2 *rows, size_t stride, size_t offset, size_t count)
+{
+  size_t done = 0;
+  size_t bytes = fmt.bits / 8;
+  while(f != NULL && done < count && frames_left > 0)
+  {
+    size_t want = count - done;
+    if(want > READ_FRAMES)
+      want = READ_FRAMES;
+    if(want > frames_left)
+      want = frames_left;
+    raw.resize(want * fmt.block_align);
+    size_t got = fread(&raw[0], fmt.block_align, want, f);
+    if(got == 0)
+    {
+      frames_left = 0;
+      break;
+    }
+
+    // de-interleave: one pass over the block, each channel to its own row
+    for(size_t i = 0; i < got; i++)
+    {
+      const unsigned char *frame = &raw[i * fmt.block_align];
+      for(unsigned int c = 0; c < fmt.channels; c++)
+      {
+        cl_float2 &v = rows[c * stride + offset + done + i];
+        v.x = decode(frame + c * bytes);
+        v.y = 0.0f;
+      }
+    }
+    done += got;
+    frames_left -= got;
+  }
+  return done;
+}
@@ -0,0 +1,51 @@
+#ifndef _WAVFILE_H_
+#define _WAVFILE_H_
+
+#include <oclUtils.h>
+#include <cstdio>
+#include <vector>
+
+/* Layout of the samples in a WAV file's data chunk. */
+struct WavFormat
+{
+    unsigned int channels;
+    unsigned int sample_rate;
+    unsigned int bits;          /* per sample: 16, 24 or 32 integer, 32 or 64 float */
+    bool is_float;
+    unsigned int block_align;   /* bytes per frame, all channels */
+    size_t frames;
+};
+
+/* Reader of RIFF/WAVE files with interleaved integer (16, 24, 32 bit) or IEEE float
+   (32, 64 bit) samples, WAVE_FORMAT_EXTENSIBLE included. Frames are decoded and
+   de-interleaved straight into one row per channel, the layout Convolver transforms
+   as a batch, so every channel goes through the device in the same launch. Samples
+   are scaled to the 16-bit range the mono pcm.pcm path works in. */
+class WavFile
+{
+    public:
+        WavFile();
+        ~WavFile();
+
+        /* Parses the header up to the data chunk. False (with the reason logged) if
+           path isn't a WAV file this reader handles. */
+        bool open(const char *path);
+        void close();
+
+        const WavFormat& format() const { return fmt; }
+
+        /* Reads up to count frames from the current position into rows: channel c of the
+           i-th frame goes to rows[c * stride + offset + i] as (sample, 0). Returns the
+           number of frames read, 0 at the end of the data. */
+        size_t readFrames(cl_float2 *rows, size_t stride, size_t offset, size_t count);
+
+    private:
+        FILE *f;
+        WavFormat fmt;
+        size_t frames_left;
+        std::vector<unsigned char> raw;
+
+        float decode(const unsigned char *p) const;
+};
+
+#endif
@@ -0,0 +1,44 @@
+// Welch averaging on the device: overlapping windowed segments are cut out of one
+// block of samples as the rows of a batch, and once Convolve.cl has transformed them
+// the power of every row is summed per bin into a running total, so only that total
+// ever goes back to the host.
+
+// row r = samples[r*hop .. r*hop + n) * window, as complex points with zero imaginary part
+__kernel void WELCH_SEGMENTS(__global const float * samples, __global const float * window, const uint n,
+                             const uint hop, __global float2 * rows)
+{
+  uint g = get_global_id(0);
+  uint r = g / n;
+  uint i = g - r * n;
+  rows[g] = (float2)(samples[r * hop + i] * window[i], 0.0f);
+}
+
+// lg_n low bits of i in reverse order
+uint reverse_bits(uint i, uint lg_n)
+{
+  uint r = 0;
+  for(uint b = 0; b < lg_n; ++b)
+  {
+    r = (r << 1) | (i & 1);
+    i >>= 1;
+  }
+  return r;
+}
+
+// psd[k] += sum over the rows of |X_r[k]|^2 for the bins k <= n/2; the rows are in the
+// bit reversed order the forward pass of Convolve.cl leaves them in
+__kernel void WELCH_ACCUMULATE(__global const float2 * rows, const uint n, const uint lg_n, const uint num_rows,
+                               __global float * psd)
+{
+  uint k = get_global_id(0);
+  if(k > (n >> 1))
+    return;
+  uint rev = reverse_bits(k, lg_n);
+  float sum = 0.0f;
+  for(uint r = 0; r < num_rows; ++r)
+  {
+    float2 v = rows[r * n + rev];
+    sum += v.s0*v.s0 + v.s1*v.s1;
+  }
+  psd[k] += sum;
+}
@@ -0,0 +1,180 @@
+#include "Welch.h"
+#include "Convolver.h"
+#include "oclFFT.h"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+Welch::Welch(Convolver& convolver, cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue,
+             size_t n, size_t hop, size_t batch, int argc, const char **argv)
+    : convolver(convolver), cqCommandQueue(cqCommandQueue), n(n), hop(hop > 0 ? hop : n / 2),
+      batch(batch > 0 ? batch : 1), count(0)
+{
+  assert(n >= 2 && Convolver::transformSize(n) == n && this->hop <= n);
+
+  cl_int ciErr;
+  size_t szKernelLength;
+  char* cPathAndName = shrFindFilePath("Welch.cl", argv[0]);
+  cSourceCL = oclLoadProgSource(cPathAndName, "", &szKernelLength);
+  free(cPathAndName);
+
+  cpProgram = clCreateProgramWithSource(cxContext, 1, (const char **)&cSourceCL, &szKernelLength, &ciErr);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clCreateProgramWithSource, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  ciErr = clBuildProgram(cpProgram, 1, &cdDevice, NULL, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    size_t log_size;
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+    char* program_log = (char *)malloc(log_size + 1);
+    program_log[log_size] = '\0';
+    clGetProgramBuildInfo(cpProgram, cdDevice, CL_PROGRAM_BUILD_LOG, log_size + 1, program_log, NULL);
+    printf("%s\n", program_log);
+    free(program_log);
+    shrLog("Error in clBuildProgram, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  ckSegments = clCreateKernel(cpProgram, "WELCH_SEGMENTS", &ciErr);
+  ckAccumulate = clCreateKernel(cpProgram, "WELCH_ACCUMULATE", &ciErr);
+  // each call overwrites ciErr, but a failed one leaves its object NULL
+  if (ckSegments == NULL || ckAccumulate == NULL)
+  {
+    shrLog("Error in clCreateKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  size_t bins = n / 2 + 1;
+  cmSamples = clCreateBuffer(cxContext, CL_MEM_READ_ONLY, sizeof(cl_float) * ((this->batch - 1) * this->hop + n), NULL, &ciErr);
+  cmWindow = clCreateBuffer(cxContext, CL_MEM_READ_ONLY, sizeof(cl_float) * n, NULL, &ciErr);
+  cmRows = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float2) * n * this->batch, NULL, &ciErr);
+  cmPSD = clCreateBuffer(cxContext, CL_MEM_READ_WRITE, sizeof(cl_float) * bins, NULL, &ciErr);
+  if (cmSamples == NULL || cmWindow == NULL || cmRows == NULL || cmPSD == NULL)
+  {
+    shrLog("Error in clCreateBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  // periodic Hann, so that at 50% overlap the windows add up to a constant
+  vector<float> window(n);
+  window_power = 0.0;
+  for(size_t i = 0; i < n; i++)
+  {
+    window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / n));
+    window_power += (double)window[i] * window[i];
+  }
+  vector<float> zeros(bins, 0.0f);
+  ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmWindow, CL_TRUE, 0, sizeof(cl_float) * n, &window[0], 0, NULL, NULL);
+  ciErr |= clEnqueueWriteBuffer(cqCommandQueue, cmPSD, CL_TRUE, 0, sizeof(cl_float) * bins, &zeros[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  cl_uint points = (cl_uint)n;
+  cl_uint step = (cl_uint)this->hop;
+  cl_uint lg_n = 0;
+  while(((size_t)1 << lg_n) < n)
+    lg_n++;
+  ciErr = clSetKernelArg(ckSegments, 0, sizeof(cl_mem), (void*)&cmSamples);
+  ciErr |= clSetKernelArg(ckSegments, 1, sizeof(cl_mem), (void*)&cmWindow);
+  ciErr |= clSetKernelArg(ckSegments, 2, sizeof(cl_uint), (void*)&points);
+  ciErr |= clSetKernelArg(ckSegments, 3, sizeof(cl_uint), (void*)&step);
+  ciErr |= clSetKernelArg(ckSegments, 4, sizeof(cl_mem), (void*)&cmRows);
+  ciErr |= clSetKernelArg(ckAccumulate, 0, sizeof(cl_mem), (void*)&cmRows);
+  ciErr |= clSetKernelArg(ckAccumulate, 1, sizeof(cl_uint), (void*)&points);
+  ciErr |= clSetKernelArg(ckAccumulate, 2, sizeof(cl_uint), (void*)&lg_n);
+  ciErr |= clSetKernelArg(ckAccumulate, 4, sizeof(cl_mem), (void*)&cmPSD);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
+
+Welch::~Welch()
+{
+  if(cmPSD)clReleaseMemObject(cmPSD);
+  if(cmRows)clReleaseMemObject(cmRows);
+  if(cmWindow)clReleaseMemObject(cmWindow);
+  if(cmSamples)clReleaseMemObject(cmSamples);
+  if(ckAccumulate)clReleaseKernel(ckAccumulate);
+  if(ckSegments)clReleaseKernel(ckSegments);
+  if(cpProgram)clReleaseProgram(cpProgram);
+  if(cSourceCL)free(cSourceCL);
+}
+
+void Welch::enqueue(cl_kernel ckKernel, size_t szGlobalWorkSize, int argc, const char **argv)
+{
+  cl_int ciErr = clEnqueueNDRangeKernel(cqCommandQueue, ckKernel, 1, NULL, &szGlobalWorkSize, NULL, 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueNDRangeKernel, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+}
+
+void Welch::process(const float *in, size_t count, int argc, const char **argv)
+{
+  pending.insert(pending.end(), in, in + count);
+  while(pending.size() >= (batch - 1) * hop + n)
+    runSegments(batch, argc, argv);
+}
+
+// Windows, transforms and accumulates the first rows segments of pending and drops
+// the samples no later segment needs.
+void Welch::runSegments(size_t rows, int argc, const char **argv)
+{
+  // blocking: pending is trimmed right after
+  size_t span = (rows - 1) * hop + n;
+  cl_int ciErr = clEnqueueWriteBuffer(cqCommandQueue, cmSamples, CL_TRUE, 0, sizeof(cl_float) * span, &pending[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueWriteBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+
+  enqueue(ckSegments, rows * n, argc, argv);
+  convolver.forward(cmRows, n, rows, argc, argv);
+  cl_uint num_rows = (cl_uint)rows;
+  ciErr = clSetKernelArg(ckAccumulate, 3, sizeof(cl_uint), (void*)&num_rows);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clSetKernelArg, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  enqueue(ckAccumulate, n / 2 + 1, argc, argv);
+
+  pending.erase(pending.begin(), pending.begin() + rows * hop);
+  count += rows;
+}
+
+vector<float> Welch::spectrum(double sample_rate, int argc, const char **argv)
+{
+  if(pending.size() >= n)
+    runSegments((pending.size() - n) / hop + 1, argc, argv);
+
+  size_t bins = n / 2 + 1;
+  vector<float> psd(bins, 0.0f);
+  cl_int ciErr = clEnqueueReadBuffer(cqCommandQueue, cmPSD, CL_TRUE, 0, sizeof(cl_float) * bins, &psd[0], 0, NULL, NULL);
+  if (ciErr != CL_SUCCESS)
+  {
+    shrLog("Error in clEnqueueReadBuffer, Line %u in file %s !!!\n\n", __LINE__, __FILE__);
+    Cleanup(argc, (char **)argv, EXIT_FAILURE);
+  }
+  if(count == 0)
+    return psd;
+
+  // every bin but DC and Nyquist also stands for its negative frequency
+  double scale = 1.0 / (sample_rate * window_power * count);
+  for(size_t k = 0; k < bins; k++)
+    psd[k] = (float)(psd[k] * scale * ((k == 0 || k == n / 2) ? 1.0 : 2.0));
+  return psd;
+}
@@ -0,0 +1,54 @@
+#ifndef _WELCH_H_
+#define _WELCH_H_
+
+#include <oclUtils.h>
+#include <vector>
+
+class Convolver;
+
+/* Welch power spectral density of a stream. Overlapping segments of n points are
+   windowed on the device (periodic Hann), transformed as the rows of one batch and
+   their power summed per bin into a running total there (Welch.cl), so memory stays
+   bounded by one batch whatever the length of the stream and only the n/2+1 bins of
+   the average are ever read back. */
+class Welch
+{
+    public:
+        /* n is a power of 2, hop the step between segments (n/2 for 50% overlap) and
+           batch the number of segments sent to the device at once. */
+        Welch(Convolver& convolver, cl_context cxContext, cl_device_id cdDevice, cl_command_queue cqCommandQueue,
+              size_t n, size_t hop, size_t batch, int argc, const char **argv);
+        ~Welch();
+
+        /* Feeds count samples of the stream; every segment they complete is added to the average. */
+        void process(const float *in, size_t count, int argc, const char **argv);
+        /* One-sided density of bins 0..n/2 in units^2 per Hz, averaged over the segments so far.
+           A trailing partial segment is left out. */
+        std::vector<float> spectrum(double sample_rate, int argc, const char **argv);
+
+        size_t segments() const { return count; }
+        size_t segmentSize() const { return n; }
+
+    private:
+        Convolver& convolver;
+        cl_command_queue cqCommandQueue;
+        cl_program cpProgram;
+        cl_kernel ckSegments;
+        cl_kernel ckAccumulate;
+        cl_mem cmSamples;           /* the samples the segments of one batch cover */
+        cl_mem cmWindow;
+        cl_mem cmRows;              /* batch rows of n points */
+        cl_mem cmPSD;               /* running sum of |X[k]|^2, n/2+1 bins */
+        size_t n;
+        size_t hop;
+        size_t batch;
+        size_t count;               /* segments summed into cmPSD */
+        double window_power;        /* sum of w[i]^2 */
+        std::vector<float> pending; /* input whose segments have not gone through yet */
+        char* cSourceCL;
+
+        void runSegments(size_t rows, int argc, const char **argv);
+        void enqueue(cl_kernel ckKernel, size_t szGlobalWorkSize, int argc, const char **argv);
+};
+
+#endif
@@ -1,6 +0,0 @@
-#ifndef _OCLFFT_H_
-#define _OCLFFT_H_
-
-void Cleanup (int argc, char **argv, int iExitCode);
-
-#endif